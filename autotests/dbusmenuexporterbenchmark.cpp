@@ -0,0 +1,238 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "dbusmenuexporter.h"
+#include "dbusmenuexporterdbus_p.h"
+#include "dbusmenutypes_p.h"
+
+#include <QAction>
+#include <QDBusArgument>
+#include <QIconEngine>
+#include <QMenu>
+#include <QPainter>
+#include <QTest>
+
+#include <utility>
+
+// An icon counting how often it is rasterized, which the exporter does once
+// for every PNG it encodes
+class CountingIconEngine : public QIconEngine
+{
+public:
+    explicit CountingIconEngine(const QColor &color)
+        : m_color(color)
+    {
+    }
+
+    void paint(QPainter *painter, const QRect &rect, QIcon::Mode, QIcon::State) override
+    {
+        painter->fillRect(rect, m_color);
+    }
+
+    QPixmap pixmap(const QSize &size, QIcon::Mode, QIcon::State) override
+    {
+        ++s_rasterizations;
+        QPixmap pixmap(size);
+        pixmap.fill(m_color);
+        return pixmap;
+    }
+
+    QIconEngine *clone() const override
+    {
+        return new CountingIconEngine(m_color);
+    }
+
+    bool isNull() override
+    {
+        return false;
+    }
+
+    static int s_rasterizations;
+
+private:
+    QColor m_color;
+};
+
+int CountingIconEngine::s_rasterizations = 0;
+
+// iconed actions in the menu, as large application menus have
+static constexpr int s_actionCount = 200;
+
+// actions in the menu for the lookup benchmarks, far more than any real one
+static constexpr int s_largeActionCount = 10000;
+
+static QIcon countingIcon(int index)
+{
+    return QIcon(new CountingIconEngine(QColor::fromRgb(index % 256, (index / 256) % 256, 128)));
+}
+
+// What a host receives when it asks for the layout, the items are only
+// written out when the reply is marshalled
+static void readLayout(DBusMenuExporterDBus *dbusObject)
+{
+    DBusMenuLayout layout;
+    dbusObject->GetLayout(0, -1, QStringList(), layout);
+    QDBusArgument argument;
+    argument << layout;
+}
+
+class DBusMenuExporterBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void initMain();
+
+private Q_SLOTS:
+    void benchmarkIconDataEncodes_data();
+    void benchmarkIconDataEncodes();
+    void testRebuiltMenuIds();
+    void benchmarkGetLayout();
+    void benchmarkGetGroupProperties();
+};
+
+void DBusMenuExporterBenchmark::initMain()
+{
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+}
+
+enum MenuChange {
+    NoChange,
+    LabelChange,
+    CheckChange,
+    IconChange,
+};
+
+void DBusMenuExporterBenchmark::benchmarkIconDataEncodes_data()
+{
+    QTest::addColumn<int>("change");
+    QTest::addColumn<int>("encodes");
+
+    QTest::newRow("first layout") << int(NoChange) << s_actionCount;
+    QTest::newRow("label changed") << int(LabelChange) << 0;
+    QTest::newRow("checkbox toggled") << int(CheckChange) << 0;
+    QTest::newRow("icon changed") << int(IconChange) << 1;
+}
+
+void DBusMenuExporterBenchmark::benchmarkIconDataEncodes()
+{
+    QFETCH(int, change);
+    QFETCH(int, encodes);
+
+    QMenu menu;
+    for (int i = 0; i < s_actionCount; ++i) {
+        QAction *action = menu.addAction(countingIcon(i), QStringLiteral("Action %1").arg(i));
+        action->setCheckable(true);
+    }
+
+    // never connected, the object is not reachable and called directly instead
+    auto exporter = new DBusMenuExporter(QStringLiteral("/MenuBar"), &menu, QDBusConnection(QStringLiteral("dbusmenuexporterbenchmark")));
+    DBusMenuExporterDBus *dbusObject = exporter->findChild<DBusMenuExporterDBus *>();
+    QVERIFY(dbusObject);
+
+    CountingIconEngine::s_rasterizations = 0;
+    readLayout(dbusObject);
+
+    if (change != NoChange) {
+        CountingIconEngine::s_rasterizations = 0;
+
+        QAction *action = menu.actions().constFirst();
+        switch (change) {
+        case LabelChange:
+            action->setText(QStringLiteral("Renamed"));
+            break;
+        case CheckChange:
+            action->setChecked(!action->isChecked());
+            break;
+        case IconChange:
+            action->setIcon(countingIcon(1000));
+            break;
+        }
+
+        // the update the exporter sends, then a host reading the layout again
+        QMetaObject::invokeMethod(exporter, "doUpdateActions");
+        readLayout(dbusObject);
+    }
+
+    QTest::setBenchmarkResult(CountingIconEngine::s_rasterizations, QTest::Events);
+    QCOMPARE(CountingIconEngine::s_rasterizations, encodes);
+}
+
+void DBusMenuExporterBenchmark::testRebuiltMenuIds()
+{
+    // a "recent items" menu, rebuilt over and over next to an action which
+    // stays, so that most ids handed out are dead
+    QMenu menu;
+    menu.addAction(QStringLiteral("Quit"));
+    auto exporter = new DBusMenuExporter(QStringLiteral("/MenuBar"), &menu, QDBusConnection(QStringLiteral("dbusmenuexporterbenchmark")));
+    DBusMenuExporterDBus *dbusObject = exporter->findChild<DBusMenuExporterDBus *>();
+    QVERIFY(dbusObject);
+
+    constexpr int rounds = 50;
+    constexpr int recentCount = 100;
+    QList<QAction *> recent;
+    for (int round = 0; round < rounds; ++round) {
+        qDeleteAll(std::exchange(recent, {}));
+        for (int i = 0; i < recentCount; ++i) {
+            recent.append(menu.addAction(QStringLiteral("Recent %1").arg(round * recentCount + i)));
+        }
+    }
+
+    // ids are handed out in sequence, the action which stayed got the first one
+    const auto label = [dbusObject](int id) {
+        return dbusObject->GetProperty(id, QStringLiteral("label")).variant().toString();
+    };
+    QCOMPARE(label(1), QStringLiteral("Quit"));
+    for (int i = 0; i < recentCount; ++i) {
+        const int index = (rounds - 1) * recentCount + i;
+        QCOMPARE(label(2 + index), QStringLiteral("Recent %1").arg(index));
+    }
+}
+
+void DBusMenuExporterBenchmark::benchmarkGetLayout()
+{
+    QMenu menu;
+    for (int i = 0; i < s_largeActionCount; ++i) {
+        menu.addAction(QStringLiteral("Action %1").arg(i));
+    }
+    auto exporter = new DBusMenuExporter(QStringLiteral("/MenuBar"), &menu, QDBusConnection(QStringLiteral("dbusmenuexporterbenchmark")));
+    DBusMenuExporterDBus *dbusObject = exporter->findChild<DBusMenuExporterDBus *>();
+    QVERIFY(dbusObject);
+
+    // every child of the root is looked up by action, then by id
+    QBENCHMARK {
+        readLayout(dbusObject);
+    }
+}
+
+void DBusMenuExporterBenchmark::benchmarkGetGroupProperties()
+{
+    QMenu menu;
+    for (int i = 0; i < s_largeActionCount; ++i) {
+        menu.addAction(QStringLiteral("Action %1").arg(i));
+    }
+    auto exporter = new DBusMenuExporter(QStringLiteral("/MenuBar"), &menu, QDBusConnection(QStringLiteral("dbusmenuexporterbenchmark")));
+    DBusMenuExporterDBus *dbusObject = exporter->findChild<DBusMenuExporterDBus *>();
+    QVERIFY(dbusObject);
+
+    // ids are handed out in sequence, the root menu has 0
+    QList<int> ids;
+    for (int id = 1; id <= s_largeActionCount; ++id) {
+        ids.append(id);
+    }
+
+    DBusMenuItemList items;
+    QBENCHMARK {
+        items = dbusObject->GetGroupProperties(ids, {QStringLiteral("label")});
+    }
+    QCOMPARE(items.size(), s_largeActionCount);
+    QCOMPARE(items.constLast().properties.value(QStringLiteral("label")).toString(), QStringLiteral("Action %1").arg(s_largeActionCount - 1));
+}
+
+QTEST_MAIN(DBusMenuExporterBenchmark)
+
+#include "dbusmenuexporterbenchmark.moc"
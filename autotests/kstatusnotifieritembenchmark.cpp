@@ -0,0 +1,94 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kstatusnotifieritem.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QTest>
+
+// the item is exported on the session bus connection of the application,
+// under the path of the first item created in shared mode
+static const QString s_itemPath = QStringLiteral("/StatusNotifierItem/1");
+
+class KStatusNotifierItemBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void initMain();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkGetAll();
+    void benchmarkStatusFlapping();
+
+private:
+    KStatusNotifierItem *m_item = nullptr;
+};
+
+void KStatusNotifierItemBenchmark::initMain()
+{
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+}
+
+void KStatusNotifierItemBenchmark::initTestCase()
+{
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.isConnected()) {
+        QSKIP("No session bus");
+    }
+
+    KStatusNotifierItem::setSharedBusConnection(true);
+    m_item = new KStatusNotifierItem(QStringLiteral("kstatusnotifieritembenchmark"));
+    m_item->setTitle(QStringLiteral("Benchmark"));
+    m_item->setIconByName(QStringLiteral("dialog-information"));
+    m_item->setToolTip(QStringLiteral("dialog-information"), QStringLiteral("Title"), QStringLiteral("Sub title"));
+
+    // the item connects in the background
+    QTRY_VERIFY(bus.objectRegisteredAt(s_itemPath));
+}
+
+void KStatusNotifierItemBenchmark::cleanupTestCase()
+{
+    delete m_item;
+}
+
+void KStatusNotifierItemBenchmark::benchmarkGetAll()
+{
+    // what a host does when it (re)discovers the item
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QDBusMessage call = QDBusMessage::createMethodCall(bus.baseService(), s_itemPath, QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("GetAll"));
+    call << QStringLiteral("org.kde.StatusNotifierItem");
+
+    QDBusMessage reply;
+    QBENCHMARK {
+        reply = bus.call(call);
+    }
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().size(), 1);
+}
+
+void KStatusNotifierItemBenchmark::benchmarkStatusFlapping()
+{
+    // an alerting tray going back and forth between its two states, each
+    // change announced with NewStatus carrying the name of the status
+    m_item->setMinimumSignalInterval(0);
+
+    bool attention = false;
+    QBENCHMARK {
+        attention = !attention;
+        m_item->setStatus(attention ? KStatusNotifierItem::NeedsAttention : KStatusNotifierItem::Active);
+        QCoreApplication::processEvents();
+    }
+    QVERIFY(m_item->status() == KStatusNotifierItem::NeedsAttention || m_item->status() == KStatusNotifierItem::Active);
+}
+
+QTEST_MAIN(KStatusNotifierItemBenchmark)
+
+#include "kstatusnotifieritembenchmark.moc"
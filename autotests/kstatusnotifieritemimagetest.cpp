@@ -0,0 +1,259 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kstatusnotifieritemimage_p.h"
+
+#include <QColor>
+#include <QTest>
+#include <QtEndian>
+
+#include <cstring>
+#include <memory>
+#include <utility>
+
+using namespace KStatusNotifierItemImage;
+
+class KStatusNotifierItemImageTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testByteOrderKernels_data();
+    void testByteOrderKernels();
+    void testImageFormats_data();
+    void testImageFormats();
+    void benchmarkByteOrder_data();
+    void benchmarkByteOrder();
+    void testRecycledImageBuffers();
+    void testEvictedCacheBuffers();
+};
+
+// every byte of a pixel differs from the others, so any misplaced one shows
+static QList<quint32> testPixels(qsizetype count)
+{
+    QList<quint32> pixels(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        pixels[i] = (0x01020304u * quint32(i + 1)) ^ 0xa5c3e1f0u;
+    }
+    return pixels;
+}
+
+// a new frame of an animated icon, every one of them different
+static QImage testFrame(int frame)
+{
+    QImage image(64, 64, QImage::Format_ARGB32);
+    image.fill(QColor::fromRgb(frame % 256, (frame / 256) % 256, 128));
+    return image;
+}
+
+void KStatusNotifierItemImageTest::testByteOrderKernels_data()
+{
+    // index in byteOrderKernels(), or -1 for copyToNetworkByteOrder() itself
+    QTest::addColumn<int>("kernel");
+
+    QTest::newRow("dispatched") << -1;
+    const QList<ByteOrderKernel> kernels = byteOrderKernels();
+    for (int i = 0; i < kernels.size(); ++i) {
+        QTest::newRow(kernels.at(i).name) << i;
+    }
+}
+
+void KStatusNotifierItemImageTest::testByteOrderKernels()
+{
+    QFETCH(int, kernel);
+    const QList<ByteOrderKernel> kernels = byteOrderKernels();
+
+    // odd widths, and tails of every length for 4 and 8 pixel wide vectors
+    const qsizetype lengths[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 256, 1021};
+    constexpr quint32 guard = 0xdeadbeef;
+
+    for (qsizetype length : lengths) {
+        // rows starting off the vector alignment, for source and destination independently
+        for (int srcOffset = 0; srcOffset < 8; ++srcOffset) {
+            for (int dstOffset = 0; dstOffset < 8; ++dstOffset) {
+                const QList<quint32> pixels = testPixels(srcOffset + length);
+                QList<quint32> buffer(dstOffset + length + 1, guard);
+                const quint32 *src = pixels.constData() + srcOffset;
+                quint32 *dst = buffer.data() + dstOffset;
+
+                if (kernel < 0) {
+                    copyToNetworkByteOrder(dst, src, length);
+                } else {
+                    const qsizetype done = kernels.at(kernel).convert(dst, src, length);
+                    QVERIFY(done >= 0 && done <= length);
+                    for (qsizetype i = done; i < length; ++i) {
+                        dst[i] = qToBigEndian(src[i]);
+                    }
+                }
+
+                const QByteArray context = QByteArray::number(length) + " pixels, source offset " + QByteArray::number(srcOffset) + ", destination offset "
+                    + QByteArray::number(dstOffset);
+                for (qsizetype i = 0; i < length; ++i) {
+                    QVERIFY2(dst[i] == qToBigEndian(src[i]), context.constData());
+                }
+                for (int i = 0; i < dstOffset; ++i) {
+                    QVERIFY2(buffer.at(i) == guard, context.constData());
+                }
+                QVERIFY2(buffer.constLast() == guard, context.constData());
+            }
+        }
+    }
+}
+
+void KStatusNotifierItemImageTest::testImageFormats_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<bool>("padded");
+
+    const std::pair<QImage::Format, const char *> formats[] = {
+        {QImage::Format_ARGB32, "ARGB32"},
+        {QImage::Format_RGB32, "RGB32"},
+        {QImage::Format_ARGB32_Premultiplied, "ARGB32_Premultiplied"},
+        {QImage::Format_RGBA8888, "RGBA8888"},
+        {QImage::Format_RGBX8888, "RGBX8888"},
+        {QImage::Format_RGBA8888_Premultiplied, "RGBA8888_Premultiplied"},
+        // no direct path, converted to ARGB32 first
+        {QImage::Format_RGB888, "RGB888"},
+    };
+    for (const auto &[format, name] : formats) {
+        QTest::addRow("%s", name) << int(format) << false;
+        QTest::addRow("%s, padded lines", name) << int(format) << true;
+    }
+}
+
+void KStatusNotifierItemImageTest::testImageFormats()
+{
+    QFETCH(int, format);
+    QFETCH(bool, padded);
+
+    // every alpha value, so premultiplied pixels get all the rounding cases,
+    // and an odd width
+    QImage argb(37, 9, QImage::Format_ARGB32);
+    for (int y = 0; y < argb.height(); ++y) {
+        for (int x = 0; x < argb.width(); ++x) {
+            const int i = y * argb.width() + x;
+            argb.setPixel(x, y, qRgba((i * 7) % 256, (i * 13 + 50) % 256, (i * 29 + 100) % 256, i % 256));
+        }
+    }
+    QImage image = argb.convertToFormat(QImage::Format(format));
+
+    // lines longer than the pixels they hold, as in images wrapping a buffer
+    // of their owner
+    QByteArray buffer;
+    if (padded) {
+        const qsizetype bytesPerLine = image.bytesPerLine() + 12;
+        buffer = QByteArray(bytesPerLine * image.height(), char(0x5a));
+        for (int y = 0; y < image.height(); ++y) {
+            memcpy(buffer.data() + y * bytesPerLine, image.constScanLine(y), image.bytesPerLine());
+        }
+        image = QImage(reinterpret_cast<const uchar *>(buffer.constData()), image.width(), image.height(), bytesPerLine, image.format());
+        QCOMPARE_GT(image.bytesPerLine(), qsizetype(image.width()) * image.depth() / 8);
+    }
+
+    const KDbusImageStruct icon = imageToStruct(image);
+    QCOMPARE(icon.width, image.width());
+    QCOMPARE(icon.height, image.height());
+    QCOMPARE(icon.data.size(), qsizetype(image.width()) * image.height() * qsizetype(sizeof(quint32)));
+
+    const QImage expected = image.convertToFormat(QImage::Format_ARGB32);
+    const quint32 *pixels = reinterpret_cast<const quint32 *>(icon.data.constData());
+    for (int y = 0; y < expected.height(); ++y) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(expected.constScanLine(y));
+        for (int x = 0; x < expected.width(); ++x) {
+            const quint32 pixel = qFromBigEndian(pixels[y * expected.width() + x]);
+            QVERIFY2(pixel == line[x], qPrintable(QStringLiteral("pixel %1,%2: %3 instead of %4").arg(x).arg(y).arg(pixel, 8, 16).arg(line[x], 8, 16)));
+        }
+    }
+}
+
+void KStatusNotifierItemImageTest::benchmarkByteOrder_data()
+{
+    QTest::addColumn<bool>("vectorized");
+
+    QTest::newRow("qToBigEndian loop") << false;
+    QTest::newRow("copyToNetworkByteOrder") << true;
+}
+
+void KStatusNotifierItemImageTest::benchmarkByteOrder()
+{
+    QFETCH(bool, vectorized);
+
+    // a 256x256 icon, as sent by monitoring applications several times a second
+    const QList<quint32> pixels = testPixels(256 * 256);
+    QList<quint32> buffer(pixels.size());
+    const quint32 *src = pixels.constData();
+    quint32 *dst = buffer.data();
+
+    if (vectorized) {
+        QBENCHMARK {
+            copyToNetworkByteOrder(dst, src, pixels.size());
+        }
+    } else {
+        QBENCHMARK {
+            for (qsizetype i = 0; i < pixels.size(); ++i) {
+                dst[i] = qToBigEndian(src[i]);
+            }
+        }
+    }
+}
+
+void KStatusNotifierItemImageTest::testRecycledImageBuffers()
+{
+    // what setIconByImage() does: the previous vector goes back to the pool
+    // while the snapshot published with it may still hold on to it
+    BufferPool pool;
+    KDbusImageVector current;
+    KDbusImageVector published;
+
+    constexpr int warmUpFrames = 10;
+    quint64 warmUpMisses = 0;
+    for (int frame = 0; frame < 50; ++frame) {
+        const QImage image = testFrame(frame);
+
+        pool.recycle(current);
+        current.clear();
+        KDbusImageStruct icon;
+        icon.data = pool.take(qsizetype(image.width()) * image.height() * qsizetype(sizeof(quint32)));
+        imageToStruct(image, icon);
+        current.append(icon);
+        published = current;
+
+        QCOMPARE(structToImage(published.constFirst()), image);
+        if (frame == warmUpFrames) {
+            warmUpMisses = pool.misses();
+        }
+    }
+    QCOMPARE(pool.misses(), warmUpMisses);
+}
+
+void KStatusNotifierItemImageTest::testEvictedCacheBuffers()
+{
+    // what a pixmap icon does: the cache holds the buffers, and gives them
+    // back to the pool when it evicts them
+    const auto pool = std::make_shared<BufferPool>();
+    ImageCache cache;
+    cache.setMaxCost(4 * 64 * 64 * qsizetype(sizeof(quint32)));
+    KDbusImageVector published;
+
+    constexpr int warmUpFrames = 10;
+    quint64 warmUpMisses = 0;
+    for (int frame = 0; frame < 50; ++frame) {
+        const QImage image = testFrame(frame);
+
+        published = {cache.imageToStruct(image, pool)};
+
+        QCOMPARE(structToImage(published.constFirst()), image);
+        if (frame == warmUpFrames) {
+            warmUpMisses = pool->misses();
+        }
+    }
+    QCOMPARE(pool->misses(), warmUpMisses);
+}
+
+QTEST_GUILESS_MAIN(KStatusNotifierItemImageTest)
+
+#include "kstatusnotifieritemimagetest.moc"
@@ -4,3 +4,4 @@
 #pragma once
 
 #include <KStatusNotifierItem>
+#include <KStatusNotifierItemUpdater>
@@ -9,6 +9,7 @@
 #include "config-kstatusnotifieritem.h"
 #include "debug_p.h"
 #include "kstatusnotifieritemprivate_p.h"
+#include "kstatusnotifieritemupdater_p.h"
 
 #include <QApplication>
 #include <QImage>
@@ -16,6 +17,7 @@
 #include <QMovie>
 #include <QPainter>
 #include <QPixmap>
+#include <QPlatformSurfaceEvent>
 #include <QPushButton>
 #include <QStandardPaths>
 #ifdef Q_OS_MACOS
@@ -24,8 +26,12 @@
 
 #if HAVE_DBUS
 #include "kstatusnotifieritemdbus_p.h"
+#include "kstatusnotifieritemimage_p.h"
+#include "kstatusnotifierwatcherclient_p.h"
 
 #include <QDBusConnection>
+#include <QPromise>
+#include <QThreadPool>
 
 #if HAVE_DBUSMENUQT
 #include "libdbusmenu-qt/dbusmenuexporter.h"
@@ -46,9 +52,9 @@ namespace MacUtils
 void setBadgeLabelText(const QString &s);
 }
 #endif
+#include <algorithm>
 #include <cstdlib>
 
-static const char s_statusNotifierWatcherServiceName[] = "org.kde.StatusNotifierWatcher";
 static const int s_legacyTrayIconSize = 24;
 
 KStatusNotifierItem::KStatusNotifierItem(QObject *parent)
@@ -67,8 +73,16 @@ KStatusNotifierItem::KStatusNotifierItem(const QString &id, QObject *parent)
 
 KStatusNotifierItem::~KStatusNotifierItem()
 {
+    if (d->updateQueue) {
+        d->updateQueue->detach();
+    }
 #if HAVE_DBUS
-    delete d->statusNotifierWatcher;
+    for (int i = 0; i < KStatusNotifierItemPrivate::IconRoleCount; ++i) {
+        d->cancelIconSerialization(static_cast<KStatusNotifierItemPrivate::IconRole>(i));
+    }
+    KStatusNotifierWatcherClient::removeItem(d.get());
+    d->statusNotifierItemDBus->detach();
+    d->statusNotifierItemDBus->deleteLater();
     delete d->notificationsClient;
 #endif
     delete d->systemTrayIcon;
@@ -89,6 +103,9 @@ QString KStatusNotifierItem::id() const
 void KStatusNotifierItem::setCategory(const ItemCategory category)
 {
     d->category = category;
+#if HAVE_DBUS
+    d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
 }
 
 KStatusNotifierItem::ItemStatus KStatusNotifierItem::status() const
@@ -104,6 +121,9 @@ KStatusNotifierItem::ItemCategory KStatusNotifierItem::category() const
 void KStatusNotifierItem::setTitle(const QString &title)
 {
     d->title = title;
+#if HAVE_DBUS
+    d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
 }
 
 void KStatusNotifierItem::setStatus(const ItemStatus status)
@@ -115,8 +135,7 @@ void KStatusNotifierItem::setStatus(const ItemStatus status)
     d->status = status;
 
 #if HAVE_DBUS
-    Q_EMIT d->statusNotifierItemDBus->NewStatus(
-        QString::fromLatin1(metaObject()->enumerator(metaObject()->indexOfEnumerator("ItemStatus")).valueToKey(d->status)));
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::StatusChanged);
 #endif
     if (d->systemTrayIcon) {
         d->syncLegacySystemTrayIcon();
@@ -132,10 +151,11 @@ void KStatusNotifierItem::setIconByName(const QString &name)
     }
 
     d->iconName = name;
+    d->iconFromImage = false;
 
 #if HAVE_DBUS
-    d->serializedIcon = KDbusImageVector();
-    Q_EMIT d->statusNotifierItemDBus->NewIcon();
+    d->clearSerializedIcon(KStatusNotifierItemPrivate::MainIcon);
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::IconChanged);
 #endif
 
     if (d->systemTrayIcon) {
@@ -150,18 +170,18 @@ QString KStatusNotifierItem::iconName() const
 
 void KStatusNotifierItem::setIconByPixmap(const QIcon &icon)
 {
-    if (d->iconName.isEmpty() && d->icon.cacheKey() == icon.cacheKey()) {
+    if (d->iconName.isEmpty() && !d->iconFromImage && d->icon.cacheKey() == icon.cacheKey()) {
         return;
     }
 
     d->iconName.clear();
+    d->iconFromImage = false;
+    d->icon = icon;
 
 #if HAVE_DBUS
-    d->serializedIcon = d->iconToVector(icon);
-    Q_EMIT d->statusNotifierItemDBus->NewIcon();
+    d->pixmapIconChanged(KStatusNotifierItemPrivate::MainIcon);
 #endif
 
-    d->icon = icon;
     if (d->systemTrayIcon) {
         d->systemTrayIcon->setIcon(icon);
     }
@@ -169,9 +189,39 @@ void KStatusNotifierItem::setIconByPixmap(const QIcon &icon)
 
 QIcon KStatusNotifierItem::iconPixmap() const
 {
+#if HAVE_DBUS
+    if (d->iconFromImage) {
+        const KDbusImageVector &vector = d->serializedIcon(KStatusNotifierItemPrivate::MainIcon);
+        if (vector.isEmpty()) {
+            return QIcon();
+        }
+        return QIcon(QPixmap::fromImage(KStatusNotifierItemImage::structToImage(vector.constFirst())));
+    }
+#endif
     return d->icon;
 }
 
+void KStatusNotifierItem::setIconByImage(const QImage &image)
+{
+    d->iconName.clear();
+    d->iconFromImage = true;
+
+#if HAVE_DBUS
+    // converted right away, the image may wrap a buffer the caller reuses
+    // or frees as soon as this returns
+    d->icon = QIcon();
+    if (d->setSerializedImage(KStatusNotifierItemPrivate::MainIcon, image)) {
+        d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::IconChanged);
+    }
+#else
+    d->icon = QIcon(QPixmap::fromImage(image));
+#endif
+
+    if (d->systemTrayIcon) {
+        d->systemTrayIcon->setIcon(QIcon(QPixmap::fromImage(image)));
+    }
+}
+
 void KStatusNotifierItem::setOverlayIconByName(const QString &name)
 {
     if (d->overlayIconName == name) {
@@ -180,7 +230,8 @@ void KStatusNotifierItem::setOverlayIconByName(const QString &name)
 
     d->overlayIconName = name;
 #if HAVE_DBUS
-    Q_EMIT d->statusNotifierItemDBus->NewOverlayIcon();
+    d->clearSerializedIcon(KStatusNotifierItemPrivate::OverlayIcon);
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::OverlayIconChanged);
 #endif
     if (d->systemTrayIcon) {
         QPixmap iconPixmap = QIcon::fromTheme(d->iconName).pixmap(s_legacyTrayIconSize, s_legacyTrayIconSize);
@@ -206,15 +257,14 @@ void KStatusNotifierItem::setOverlayIconByPixmap(const QIcon &icon)
     }
 
     d->overlayIconName.clear();
+    d->overlayIcon = icon;
 
 #if HAVE_DBUS
-    d->serializedOverlayIcon = d->iconToVector(icon);
-    Q_EMIT d->statusNotifierItemDBus->NewOverlayIcon();
+    d->pixmapIconChanged(KStatusNotifierItemPrivate::OverlayIcon);
 #endif
 
-    d->overlayIcon = icon;
     if (d->systemTrayIcon) {
-        QPixmap iconPixmap = d->icon.pixmap(s_legacyTrayIconSize, s_legacyTrayIconSize);
+        QPixmap iconPixmap = this->iconPixmap().pixmap(s_legacyTrayIconSize, s_legacyTrayIconSize);
         QPixmap overlayPixmap = d->overlayIcon.pixmap(s_legacyTrayIconSize / 2, s_legacyTrayIconSize / 2);
 
         QPainter p(&iconPixmap);
@@ -240,8 +290,8 @@ void KStatusNotifierItem::setAttentionIconByName(const QString &name)
     d->attentionIconName = name;
 
 #if HAVE_DBUS
-    d->serializedAttentionIcon = KDbusImageVector();
-    Q_EMIT d->statusNotifierItemDBus->NewAttentionIcon();
+    d->clearSerializedIcon(KStatusNotifierItemPrivate::AttentionIcon);
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::AttentionIconChanged);
 #endif
 }
 
@@ -260,8 +310,7 @@ void KStatusNotifierItem::setAttentionIconByPixmap(const QIcon &icon)
     d->attentionIcon = icon;
 
 #if HAVE_DBUS
-    d->serializedAttentionIcon = d->iconToVector(icon);
-    Q_EMIT d->statusNotifierItemDBus->NewAttentionIcon();
+    d->pixmapIconChanged(KStatusNotifierItemPrivate::AttentionIcon);
 #endif
 }
 
@@ -282,7 +331,7 @@ void KStatusNotifierItem::setAttentionMovieByName(const QString &name)
     d->movie = nullptr;
 
 #if HAVE_DBUS
-    Q_EMIT d->statusNotifierItemDBus->NewAttentionIcon();
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::AttentionIconChanged);
 #endif
 
     if (d->systemTrayIcon) {
@@ -340,8 +389,8 @@ void KStatusNotifierItem::setToolTip(const QString &iconName, const QString &tit
     d->toolTipSubTitle = subTitle;
 
 #if HAVE_DBUS
-    d->serializedToolTipIcon = KDbusImageVector();
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    d->clearSerializedIcon(KStatusNotifierItemPrivate::ToolTipIcon);
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::ToolTipChanged);
 #endif
 }
 
@@ -353,6 +402,11 @@ void KStatusNotifierItem::setToolTip(const QIcon &icon, const QString &title, co
         return;
     }
 
+#if HAVE_DBUS
+    const bool textChanged = d->toolTipTitle != title || d->toolTipSubTitle != subTitle;
+    const bool iconChanged = !d->toolTipIconName.isEmpty() || d->toolTipIcon.cacheKey() != icon.cacheKey();
+#endif
+
     d->toolTipIconName.clear();
     d->toolTipIcon = icon;
 
@@ -361,8 +415,12 @@ void KStatusNotifierItem::setToolTip(const QIcon &icon, const QString &title, co
 
     d->toolTipSubTitle = subTitle;
 #if HAVE_DBUS
-    d->serializedToolTipIcon = d->iconToVector(icon);
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    if (iconChanged) {
+        d->pixmapIconChanged(KStatusNotifierItemPrivate::ToolTipIcon);
+    }
+    if (textChanged) {
+        d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::ToolTipChanged);
+    }
 #endif
 }
 
@@ -374,8 +432,8 @@ void KStatusNotifierItem::setToolTipIconByName(const QString &name)
 
     d->toolTipIconName = name;
 #if HAVE_DBUS
-    d->serializedToolTipIcon = KDbusImageVector();
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    d->clearSerializedIcon(KStatusNotifierItemPrivate::ToolTipIcon);
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::ToolTipChanged);
 #endif
 }
 
@@ -394,8 +452,7 @@ void KStatusNotifierItem::setToolTipIconByPixmap(const QIcon &icon)
     d->toolTipIcon = icon;
 
 #if HAVE_DBUS
-    d->serializedToolTipIcon = d->iconToVector(icon);
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    d->pixmapIconChanged(KStatusNotifierItemPrivate::ToolTipIcon);
 #endif
 }
 
@@ -413,7 +470,7 @@ void KStatusNotifierItem::setToolTipTitle(const QString &title)
     d->toolTipTitle = title;
 
 #if HAVE_DBUS
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::ToolTipChanged);
 #endif
     setTrayToolTip(d->systemTrayIcon, title, d->toolTipSubTitle);
 }
@@ -431,7 +488,7 @@ void KStatusNotifierItem::setToolTipSubTitle(const QString &subTitle)
 
     d->toolTipSubTitle = subTitle;
 #if HAVE_DBUS
-    Q_EMIT d->statusNotifierItemDBus->NewToolTip();
+    d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::ToolTipChanged);
 #else
     setTrayToolTip(d->systemTrayIcon, d->toolTipTitle, subTitle);
 #endif
@@ -464,11 +521,22 @@ void KStatusNotifierItem::setContextMenu(QMenu *menu)
             // systemtray applet.
             d->menuObjectPath = QStringLiteral("/NO_DBUSMENU");
             menu->installEventFilter(this);
+#if HAVE_DBUS
+            d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
         } else {
-            d->menuObjectPath = QStringLiteral("/MenuBar");
+#if HAVE_DBUS
+            d->menuObjectPath = d->statusNotifierItemDBus->menuObjectPath();
+#endif
 #if HAVE_DBUSMENUQT
-            new DBusMenuExporter(d->menuObjectPath, menu, d->statusNotifierItemDBus->dbusConnection());
-            Q_EMIT d->statusNotifierItemDBus->NewMenu();
+            d->statusNotifierItemDBus->whenConnected([this, menu = QPointer<QMenu>(menu)]() {
+                if (!menu) {
+                    // replaced by another menu in the meantime
+                    return;
+                }
+                new DBusMenuExporter(d->menuObjectPath, menu, d->statusNotifierItemDBus->dbusConnection());
+                d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::MenuChanged);
+            });
 #endif
         }
 
@@ -496,12 +564,20 @@ void KStatusNotifierItem::setAssociatedWindow(QWindow *associatedWindow)
         d->associatedWindow->removeEventFilter(this);
         d->associatedWindow = nullptr;
     }
+    d->associatedWindowId = 0;
 
     if (associatedWindow) {
         d->associatedWindow = associatedWindow;
         d->associatedWindow->installEventFilter(this);
         d->associatedWindowPos = QPoint(-1, -1);
+        d->associatedWindowId = associatedWindow->winId();
     }
+#if HAVE_DBUS
+    // not there yet when called from the constructor
+    if (d->statusNotifierItemDBus) {
+        d->statusNotifierItemDBus->invalidateSnapshot();
+    }
+#endif
 
     if (d->systemTrayIcon) {
         delete d->systemTrayIcon;
@@ -536,6 +612,13 @@ void KStatusNotifierItem::setAssociatedWindow(QWindow *associatedWindow)
 
         d->onAllDesktops = false;
     }
+
+#if HAVE_DBUS
+    // not created yet when called from init()
+    if (d->statusNotifierItemDBus) {
+        d->statusNotifierItemDBus->invalidateSnapshot();
+    }
+#endif
 }
 
 QWindow *KStatusNotifierItem::associatedWindow() const
@@ -645,8 +728,7 @@ void KStatusNotifierItem::activate(const QPoint &pos)
         MacUtils::setBadgeLabelText(QString());
 #endif
 #if HAVE_DBUS
-        Q_EMIT d->statusNotifierItemDBus->NewStatus(
-            QString::fromLatin1(metaObject()->enumerator(metaObject()->indexOfEnumerator("ItemStatus")).valueToKey(d->status)));
+        d->statusNotifierItemDBus->scheduleChangeSignal(KStatusNotifierItemDBus::StatusChanged);
 #endif
     }
 
@@ -682,6 +764,9 @@ QString KStatusNotifierItem::providedToken() const
 void KStatusNotifierItem::setIsMenu(bool isMenu)
 {
     d->isMenu = isMenu;
+#if HAVE_DBUS
+    d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
 }
 
 bool KStatusNotifierItem::isMenu() const
@@ -689,6 +774,147 @@ bool KStatusNotifierItem::isMenu() const
     return d->isMenu;
 }
 
+void KStatusNotifierItem::setIconPixmapSizes(const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios)
+{
+    const QList<qreal> ratios = devicePixelRatios.isEmpty() ? QList<qreal>{1.0} : devicePixelRatios;
+    if (d->iconPixmapSizes == sizes && d->iconPixmapDevicePixelRatios == ratios) {
+        return;
+    }
+
+    d->iconPixmapSizes = sizes;
+    d->iconPixmapDevicePixelRatios = ratios;
+
+#if HAVE_DBUS
+    d->updateRenderedIconPixmapSizes();
+#endif
+}
+
+QList<QSize> KStatusNotifierItem::iconPixmapSizes() const
+{
+    return d->iconPixmapSizes;
+}
+
+QList<qreal> KStatusNotifierItem::iconPixmapDevicePixelRatios() const
+{
+    return d->iconPixmapDevicePixelRatios;
+}
+
+void KStatusNotifierItem::setAsynchronousIconSerialization(bool enabled)
+{
+    d->asyncIconSerialization = enabled;
+}
+
+bool KStatusNotifierItem::asynchronousIconSerialization() const
+{
+    return d->asyncIconSerialization;
+}
+
+void KStatusNotifierItem::setMinimumSignalInterval(int msec)
+{
+    d->minimumSignalInterval = qMax(0, msec);
+}
+
+int KStatusNotifierItem::minimumSignalInterval() const
+{
+    return d->minimumSignalInterval;
+}
+
+void KStatusNotifierItem::setPropertiesChangedSignals(bool enabled)
+{
+    d->propertiesChangedSignals = enabled;
+#if HAVE_DBUS
+    d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
+}
+
+bool KStatusNotifierItem::propertiesChangedSignals() const
+{
+    return d->propertiesChangedSignals;
+}
+
+void KStatusNotifierItem::setSharedBusConnection(bool shared)
+{
+#if HAVE_DBUS
+    KStatusNotifierItemDBus::setSharedConnection(shared);
+#else
+    Q_UNUSED(shared)
+#endif
+}
+
+bool KStatusNotifierItem::sharedBusConnection()
+{
+#if HAVE_DBUS
+    return KStatusNotifierItemDBus::sharedConnection();
+#else
+    return false;
+#endif
+}
+
+bool KStatusNotifierItem::isRegistered() const
+{
+#if HAVE_DBUS
+    return d->registered;
+#else
+    return false;
+#endif
+}
+
+qint64 KStatusNotifierItem::registrationTime() const
+{
+#if HAVE_DBUS
+    return d->registered ? d->registrationTime : -1;
+#else
+    return -1;
+#endif
+}
+
+void KStatusNotifierItem::beginUpdate()
+{
+    ++d->updateDepth;
+}
+
+void KStatusNotifierItem::commitUpdate()
+{
+    if (d->updateDepth == 0) {
+        qCWarning(LOG_KSTATUSNOTIFIERITEM) << "commitUpdate() called without beginUpdate()";
+        return;
+    }
+    if (--d->updateDepth > 0) {
+        return;
+    }
+
+#if HAVE_DBUS
+    d->statusNotifierItemDBus->releaseChanges();
+#endif
+}
+
+quint64 KStatusNotifierItem::suppressedIconUpdates() const
+{
+#if HAVE_DBUS
+    return d->suppressedIconUpdates;
+#else
+    return 0;
+#endif
+}
+
+void KStatusNotifierItem::setIconCacheLimit(qsizetype bytes)
+{
+#if HAVE_DBUS
+    KStatusNotifierItemImage::ImageCache::self()->setMaxCost(bytes);
+#else
+    Q_UNUSED(bytes)
+#endif
+}
+
+qsizetype KStatusNotifierItem::iconCacheLimit()
+{
+#if HAVE_DBUS
+    return KStatusNotifierItemImage::ImageCache::self()->maxCost();
+#else
+    return 0;
+#endif
+}
+
 bool KStatusNotifierItemPrivate::checkVisibility(QPoint pos, bool perform)
 {
     // mapped = visible (but possibly obscured)
@@ -798,6 +1024,14 @@ bool KStatusNotifierItem::eventFilter(QObject *watched, QEvent *event)
             d->associatedWindow->setPosition(d->associatedWindowPos);
         } else if (event->type() == QEvent::Hide) {
             d->associatedWindowPos = d->associatedWindow->position();
+        } else if (event->type() == QEvent::WinIdChange || event->type() == QEvent::PlatformSurface) {
+            // the native window was created again, or is going away
+            const bool destroyed = event->type() == QEvent::PlatformSurface
+                && static_cast<QPlatformSurfaceEvent *>(event)->surfaceEventType() == QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed;
+            d->associatedWindowId = destroyed ? 0 : d->associatedWindow->winId();
+#if HAVE_DBUS
+            d->statusNotifierItemDBus->invalidateSnapshot();
+#endif
         }
     }
 
@@ -832,6 +1066,16 @@ KStatusNotifierItemPrivate::KStatusNotifierItemPrivate(KStatusNotifierItem *item
     , onAllDesktops(false)
     , standardActionsEnabled(true)
 {
+    iconPixmapDevicePixelRatios = {1.0};
+    renderedIconPixmapDevicePixelRatios = {1.0};
+}
+
+std::shared_ptr<KStatusNotifierItemUpdateQueue> KStatusNotifierItemPrivate::sharedUpdateQueue()
+{
+    if (!updateQueue) {
+        updateQueue = std::make_shared<KStatusNotifierItemUpdateQueue>(q);
+    }
+    return updateQueue;
 }
 
 void KStatusNotifierItemPrivate::init(const QString &extraId)
@@ -845,12 +1089,6 @@ void KStatusNotifierItemPrivate::init(const QString &extraId)
     qDBusRegisterMetaType<KDbusToolTipStruct>();
 
     statusNotifierItemDBus = new KStatusNotifierItemDBus(q);
-
-    QDBusServiceWatcher *watcher = new QDBusServiceWatcher(QString::fromLatin1(s_statusNotifierWatcherServiceName),
-                                                           QDBusConnection::sessionBus(),
-                                                           QDBusServiceWatcher::WatchForOwnerChange,
-                                                           q);
-    QObject::connect(watcher, SIGNAL(serviceOwnerChanged(QString, QString, QString)), q, SLOT(serviceChange(QString, QString, QString)));
 #endif
 
     // create a default menu, just like in KSystemtrayIcon
@@ -903,63 +1141,62 @@ void KStatusNotifierItemPrivate::init(const QString &extraId)
 
 void KStatusNotifierItemPrivate::registerToDaemon()
 {
-    bool useLegacy = false;
 #if HAVE_DBUS
     qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Registering a client interface to the KStatusNotifierWatcher";
-    if (!statusNotifierWatcher) {
-        statusNotifierWatcher = new org::kde::StatusNotifierWatcher(QString::fromLatin1(s_statusNotifierWatcherServiceName),
-                                                                    QStringLiteral("/StatusNotifierWatcher"),
-                                                                    QDBusConnection::sessionBus());
-    }
-
-    if (statusNotifierWatcher->isValid()) {
-        // get protocol version in async way
-        QDBusMessage msg = QDBusMessage::createMethodCall(QString::fromLatin1(s_statusNotifierWatcherServiceName),
-                                                          QStringLiteral("/StatusNotifierWatcher"),
-                                                          QStringLiteral("org.freedesktop.DBus.Properties"),
-                                                          QStringLiteral("Get"));
-        msg.setArguments(QVariantList{QStringLiteral("org.kde.StatusNotifierWatcher"), QStringLiteral("ProtocolVersion")});
-        QDBusPendingCall async = QDBusConnection::sessionBus().asyncCall(msg);
-        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(async, q);
-        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, q, [this, watcher] {
-            watcher->deleteLater();
-            QDBusPendingReply<QVariant> reply = *watcher;
-            if (reply.isError()) {
-                qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Failed to read protocol version of KStatusNotifierWatcher";
-                setLegacySystemTrayEnabled(true);
-            } else {
-                bool ok = false;
-                const int protocolVersion = reply.value().toInt(&ok);
-                if (ok && protocolVersion == s_protocolVersion) {
-                    statusNotifierWatcher->RegisterStatusNotifierItem(statusNotifierItemDBus->service());
-                    setLegacySystemTrayEnabled(false);
-                } else {
-                    qCDebug(LOG_KSTATUSNOTIFIERITEM) << "KStatusNotifierWatcher has incorrect protocol version";
-                    setLegacySystemTrayEnabled(true);
-                }
-            }
-        });
-    } else {
-        qCDebug(LOG_KSTATUSNOTIFIERITEM) << "KStatusNotifierWatcher not reachable";
-        useLegacy = true;
-    }
+    registrationTimer.start();
+    registered = false;
+    // replies to an earlier attempt are ignored, the watcher went away in between
+    ++registrationAttempt;
+    KStatusNotifierWatcherClient::self()->registerItem(this);
 #else
-    useLegacy = true;
+    setLegacySystemTrayEnabled(true);
 #endif
-    setLegacySystemTrayEnabled(useLegacy);
 }
 
+#if HAVE_DBUS
+void KStatusNotifierItemPrivate::registrationSucceeded()
+{
+    registered = true;
+    registrationTime = registrationTimer.elapsed();
+    qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Registered to the KStatusNotifierWatcher after" << registrationTime << "ms";
+    setLegacySystemTrayEnabled(false);
+
+    // the icons changed while unregistered are converted on the next flush,
+    // before the signals announcing them
+    statusNotifierItemDBus->invalidateSnapshot();
+    Q_EMIT q->registered();
+}
+
+void KStatusNotifierItemPrivate::registrationFailed()
+{
+    ++registrationAttempt;
+    setLegacySystemTrayEnabled(true);
+}
+
+void KStatusNotifierItemPrivate::hostRegisteredChanged()
+{
+    if (hostsListening()) {
+        statusNotifierItemDBus->invalidateSnapshot();
+    }
+}
+
+bool KStatusNotifierItemPrivate::hostsListening() const
+{
+    return registered && KStatusNotifierWatcherClient::self()->isHostRegistered();
+}
+#endif
+
 void KStatusNotifierItemPrivate::serviceChange(const QString &name, const QString &oldOwner, const QString &newOwner)
 {
     Q_UNUSED(name)
     if (newOwner.isEmpty()) {
         // unregistered
         qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Connection to the KStatusNotifierWatcher lost";
-        setLegacyMode(true);
 #if HAVE_DBUS
-        delete statusNotifierWatcher;
-        statusNotifierWatcher = nullptr;
+        ++registrationAttempt;
+        registered = false;
 #endif
+        setLegacyMode(true);
     } else if (oldOwner.isEmpty()) {
         // registered
         setLegacyMode(false);
@@ -1099,14 +1336,15 @@ void KStatusNotifierItemPrivate::syncLegacySystemTrayIcon()
             QIcon theIcon = QIcon::fromTheme(iconName);
             systemTrayIcon->setIconWithMask(theIcon, status == KStatusNotifierItem::Passive);
         } else {
-            systemTrayIcon->setIconWithMask(icon, status == KStatusNotifierItem::Passive);
+            QIcon theIcon = q->iconPixmap();
+            systemTrayIcon->setIconWithMask(theIcon, status == KStatusNotifierItem::Passive);
         }
         MacUtils::setBadgeLabelText(QString());
 #else
         if (!iconName.isNull()) {
             systemTrayIcon->setIcon(QIcon::fromTheme(iconName));
         } else {
-            systemTrayIcon->setIcon(icon);
+            systemTrayIcon->setIcon(q->iconPixmap());
         }
 #endif
     }
@@ -1208,47 +1446,347 @@ void KStatusNotifierItemPrivate::minimizeRestore(bool show)
 #if HAVE_DBUS
 KDbusImageStruct KStatusNotifierItemPrivate::imageToStruct(const QImage &image)
 {
-    KDbusImageStruct icon;
-    icon.width = image.size().width();
-    icon.height = image.size().height();
-    if (image.format() == QImage::Format_ARGB32) {
-        icon.data = QByteArray((char *)image.bits(), image.sizeInBytes());
-    } else {
-        QImage image32 = image.convertToFormat(QImage::Format_ARGB32);
-        icon.data = QByteArray((char *)image32.bits(), image32.sizeInBytes());
+    return KStatusNotifierItemImage::ImageCache::self()->imageToStruct(image, bufferPool);
+}
+
+const QIcon &KStatusNotifierItemPrivate::iconForRole(IconRole role) const
+{
+    switch (role) {
+    case OverlayIcon:
+        return overlayIcon;
+    case AttentionIcon:
+        return attentionIcon;
+    case ToolTipIcon:
+        return toolTipIcon;
+    case MainIcon:
+    default:
+        return icon;
     }
+}
+
+const KDbusImageVector &KStatusNotifierItemPrivate::serializedIcon(IconRole role) const
+{
+    return serializedIcons[role].vector;
+}
+
+KStatusNotifierItemDBus::ChangeSignal KStatusNotifierItemPrivate::changeSignalForRole(IconRole role)
+{
+    switch (role) {
+    case OverlayIcon:
+        return KStatusNotifierItemDBus::OverlayIconChanged;
+    case AttentionIcon:
+        return KStatusNotifierItemDBus::AttentionIconChanged;
+    case ToolTipIcon:
+        return KStatusNotifierItemDBus::ToolTipChanged;
+    case MainIcon:
+    default:
+        return KStatusNotifierItemDBus::IconChanged;
+    }
+}
+
+void KStatusNotifierItemPrivate::cancelIconSerialization(IconRole role)
+{
+    SerializedIcon &serialized = serializedIcons[role];
+    serialized.job.cancel();
+    serialized.job = {};
+    serialized.pending = false;
+    ++serialized.generation;
+}
+
+void KStatusNotifierItemPrivate::clearSerializedIcon(IconRole role)
+{
+    cancelIconSerialization(role);
+    SerializedIcon &serialized = serializedIcons[role];
+    if (!serialized.cacheKey) {
+        // buffers of a raw image, the cache does not know about them
+        bufferPool->recycle(serialized.vector);
+    }
+    serialized.vector.clear();
+    ++serialized.revision;
+    serialized.fingerprint.clear();
+    serialized.cacheKey.reset();
+    serialized.hasFingerprint = false;
+    serialized.dirty = false;
+}
+
+void KStatusNotifierItemPrivate::pixmapIconChanged(IconRole role)
+{
+    // nothing is rasterized here, an icon replaced several times before the
+    // next flush is only converted once, see serializeChangedIcons()
+    cancelIconSerialization(role);
+    serializedIcons[role].dirty = true;
+    statusNotifierItemDBus->invalidateSnapshot();
+}
 
-    // swap to network byte order if we are little endian
-    if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
-        quint32 *uintBuf = (quint32 *)icon.data.data();
-        for (uint i = 0; i < icon.data.size() / sizeof(quint32); ++i) {
-            *uintBuf = qToBigEndian(*uintBuf);
-            ++uintBuf;
+KStatusNotifierItemDBus::ChangeSignals KStatusNotifierItemPrivate::serializeChangedIcons()
+{
+    KStatusNotifierItemDBus::ChangeSignals changes;
+    // nobody would read them, the icons stay dirty until a host shows up
+    if (!hostsListening()) {
+        return changes;
+    }
+
+    for (int i = 0; i < IconRoleCount; ++i) {
+        const IconRole role = IconRole(i);
+        SerializedIcon &serialized = serializedIcons[role];
+        if (!std::exchange(serialized.dirty, false)) {
+            continue;
+        }
+
+        // the same QIcon as the one sent last, set again after another one
+        const QIcon &icon = iconForRole(role);
+        if (serialized.cacheKey == icon.cacheKey()) {
+            ++suppressedIconUpdates;
+            continue;
+        }
+
+        if (asyncIconSerialization) {
+            scheduleIconSerialization(role);
+        } else if (serializePixmapIcon(role)) {
+            changes |= changeSignalForRole(role);
         }
     }
+    return changes;
+}
 
-    return icon;
+bool KStatusNotifierItemPrivate::serializePixmapIcon(IconRole role)
+{
+    SerializedIcon &serialized = serializedIcons[role];
+    const QIcon &icon = iconForRole(role);
+    const QList<QImage> images = iconImages(icon, renderedIconPixmapSizes, renderedIconPixmapDevicePixelRatios);
+
+    SerializedIconResult result;
+    result.cacheKey = icon.cacheKey();
+    result.fingerprint = imagesFingerprint(images);
+    // a new QIcon with the same pixels keeps the buffers sent last
+    if (!serialized.hasFingerprint || serialized.fingerprint != result.fingerprint) {
+        result.vector.reserve(images.size());
+        for (const QImage &image : images) {
+            result.vector.append(imageToStruct(image));
+        }
+    }
+    return setSerializedIcon(role, result);
 }
 
-KDbusImageVector KStatusNotifierItemPrivate::iconToVector(const QIcon &icon)
+bool KStatusNotifierItemPrivate::setSerializedIcon(IconRole role, const SerializedIconResult &result)
 {
-    KDbusImageVector iconVector;
+    SerializedIcon &serialized = serializedIcons[role];
+    serialized.cacheKey = result.cacheKey;
+    if (serialized.hasFingerprint && serialized.fingerprint == result.fingerprint) {
+        ++suppressedIconUpdates;
+        return false;
+    }
 
-    QPixmap iconPixmap;
+    serialized.fingerprint = result.fingerprint;
+    serialized.hasFingerprint = true;
+    // the buffers stay in the image cache, which recycles them once it drops them
+    serialized.vector = result.vector;
+    ++serialized.revision;
+    return true;
+}
+
+void KStatusNotifierItemPrivate::scheduleIconSerialization(IconRole role)
+{
+    cancelIconSerialization(role);
+
+    SerializedIcon &serialized = serializedIcons[role];
+    const quint64 generation = serialized.generation;
+    const QIcon &icon = iconForRole(role);
+    const qint64 cacheKey = icon.cacheKey();
+
+    // neither the icon engines nor the icon theme are safe to use from another
+    // thread, so the icon is rendered here and only the images are handed over
+    const QList<QImage> images = iconImages(icon, renderedIconPixmapSizes, renderedIconPixmapDevicePixelRatios);
+
+    auto promise = std::make_shared<QPromise<SerializedIconResult>>();
+    serialized.job = promise->future();
+    serialized.pending = true;
+
+    QThreadPool::globalInstance()->start([promise, images, cacheKey, pool = bufferPool]() {
+        promise->start();
+
+        SerializedIconResult result;
+        result.cacheKey = cacheKey;
+        result.fingerprint = imagesFingerprint(images);
+        result.vector.reserve(images.size());
+        for (const QImage &image : images) {
+            if (promise->isCanceled()) {
+                // a newer icon superseded this one
+                break;
+            }
+            result.vector.append(KStatusNotifierItemImage::ImageCache::self()->imageToStruct(image, pool));
+        }
+
+        if (!promise->isCanceled()) {
+            promise->addResult(std::move(result));
+        }
+        promise->finish();
+    });
+
+    serialized.job.then(q, [this, role, generation](const SerializedIconResult &result) {
+        iconSerializationFinished(role, generation, result);
+    });
+}
+
+void KStatusNotifierItemPrivate::iconSerializationFinished(IconRole role, quint64 generation, const SerializedIconResult &result)
+{
+    SerializedIcon &serialized = serializedIcons[role];
+    if (serialized.generation != generation) {
+        return;
+    }
+
+    serialized.job = {};
+    serialized.pending = false;
+    if (setSerializedIcon(role, result)) {
+        statusNotifierItemDBus->scheduleChangeSignal(changeSignalForRole(role));
+    }
+}
+
+bool KStatusNotifierItemPrivate::setSerializedImage(IconRole role, const QImage &image)
+{
+    cancelIconSerialization(role);
+
+    SerializedIcon &serialized = serializedIcons[role];
+    QList<quint64> fingerprint;
+    if (!image.isNull()) {
+        fingerprint.append(KStatusNotifierItemImage::contentHash(image));
+    }
+    // not made from a QIcon, a pixmap icon set afterwards must be converted
+    const bool ownBuffers = !serialized.cacheKey;
+    serialized.cacheKey.reset();
+    serialized.dirty = false;
+    if (serialized.hasFingerprint && serialized.fingerprint == fingerprint) {
+        ++suppressedIconUpdates;
+        return false;
+    }
+    serialized.fingerprint = std::move(fingerprint);
+    serialized.hasFingerprint = true;
+
+    // raw images bypass the image cache, so the previous buffer can be
+    // written over once the snapshot it was published with is replaced,
+    // which is usually the case for the one before it already
+    if (ownBuffers) {
+        bufferPool->recycle(serialized.vector);
+    }
+    serialized.vector.clear();
+
+    if (!image.isNull()) {
+        KDbusImageStruct imageStruct;
+        imageStruct.data = bufferPool->take(qsizetype(image.width()) * image.height() * qsizetype(sizeof(quint32)));
+        KStatusNotifierItemImage::imageToStruct(image, imageStruct);
+        serialized.vector.append(std::move(imageStruct));
+    }
+    ++serialized.revision;
+
+    return true;
+}
+
+QList<QImage> KStatusNotifierItemPrivate::iconImages(const QIcon &icon, const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios)
+{
+    QList<QImage> images;
+    if (icon.isNull()) {
+        return images;
+    }
+
+    if (!sizes.isEmpty()) {
+        // only produce what the host is going to draw
+        for (qreal devicePixelRatio : devicePixelRatios) {
+            for (QSize size : sizes) {
+                const QPixmap iconPixmap = icon.pixmap(size, devicePixelRatio);
+                if (iconPixmap.isNull()) {
+                    continue;
+                }
+                const bool known = std::any_of(images.cbegin(), images.cend(), [&iconPixmap](const QImage &image) {
+                    return image.size() == iconPixmap.size();
+                });
+                if (!known) {
+                    images.append(iconPixmap.toImage());
+                }
+            }
+        }
+        return images;
+    }
 
     // if an icon exactly that size wasn't found don't add it to the vector
     auto lstSizes = icon.availableSizes();
-    if (lstSizes.isEmpty() && !icon.isNull()) {
+    if (lstSizes.isEmpty()) {
         // if the icon is a svg icon, then available Sizes will be empty, try some common sizes
         lstSizes = {{16, 16}, {22, 22}, {32, 32}};
     }
-    for (QSize size : lstSizes) {
-        iconPixmap = icon.pixmap(size);
+    for (QSize size : std::as_const(lstSizes)) {
+        const QPixmap iconPixmap = icon.pixmap(size);
         if (!iconPixmap.isNull()) {
-            iconVector.append(imageToStruct(iconPixmap.toImage()));
+            images.append(iconPixmap.toImage());
+        }
+    }
+    return images;
+}
+
+QList<quint64> KStatusNotifierItemPrivate::imagesFingerprint(const QList<QImage> &images)
+{
+    QList<quint64> fingerprint;
+    fingerprint.reserve(images.size());
+    for (const QImage &image : images) {
+        fingerprint.append(KStatusNotifierItemImage::contentHash(image));
+    }
+    return fingerprint;
+}
+
+void KStatusNotifierItemPrivate::setHostIconPixmapSizes(const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios)
+{
+    hostIconPixmapSizes = sizes;
+    hostIconPixmapDevicePixelRatios = devicePixelRatios;
+    updateRenderedIconPixmapSizes();
+}
+
+void KStatusNotifierItemPrivate::updateRenderedIconPixmapSizes()
+{
+    // the sizes of the application are kept when the hosts come and go, and
+    // those of the hosts added to them
+    QList<QSize> sizes = iconPixmapSizes;
+    QList<qreal> ratios = iconPixmapDevicePixelRatios;
+    if (!hostIconPixmapSizes.isEmpty()) {
+        if (sizes.isEmpty()) {
+            // the host sizes replace the sizes of each icon, not add to them
+            ratios.clear();
+        }
+        for (QSize size : std::as_const(hostIconPixmapSizes)) {
+            if (!sizes.contains(size)) {
+                sizes.append(size);
+            }
         }
+        for (qreal ratio : std::as_const(hostIconPixmapDevicePixelRatios)) {
+            if (!ratios.contains(ratio)) {
+                ratios.append(ratio);
+            }
+        }
+    }
+    if (ratios.isEmpty()) {
+        ratios.append(1.0);
+    }
+
+    if (renderedIconPixmapSizes == sizes && renderedIconPixmapDevicePixelRatios == ratios) {
+        return;
+    }
+    renderedIconPixmapSizes = sizes;
+    renderedIconPixmapDevicePixelRatios = ratios;
+    iconPixmapSizesChanged();
+}
+
+void KStatusNotifierItemPrivate::iconPixmapSizesChanged()
+{
+    for (int i = 0; i < IconRoleCount; ++i) {
+        const IconRole role = static_cast<IconRole>(i);
+        SerializedIcon &serialized = serializedIcons[role];
+        if (!serialized.cacheKey && !serialized.pending) {
+            // set by name or from a raw image, not set at all, or converted
+            // on the next flush anyway
+            continue;
+        }
+
+        serialized.cacheKey.reset();
+        pixmapIconChanged(role);
     }
-    return iconVector;
 }
 #endif
 
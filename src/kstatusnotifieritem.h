@@ -19,6 +19,7 @@
 #include <memory>
 
 class QAction;
+class QImage;
 
 class KStatusNotifierItemPrivate;
 
@@ -82,6 +83,7 @@ class KSTATUSNOTIFIERITEM_EXPORT KStatusNotifierItem : public QObject
 
     friend class KStatusNotifierItemDBus;
     friend class KStatusNotifierItemPrivate;
+    friend class KStatusNotifierItemUpdater;
 
 public:
     /*!
@@ -245,6 +247,26 @@ public:
      */
     QIcon iconPixmap() const;
 
+    /*!
+     * \brief Sets a new main icon for the system tray from raw image data.
+     *
+     * This is meant for icons generated programmatically and updated
+     * frequently, like live graphs. The \a image is converted for the host
+     * before this returns, without going through QIcon and QPixmap, and the
+     * buffer of the previous image is reused when the size did not change.
+     *
+     * No reference to \a image is kept, so it may wrap a buffer of the
+     * application with one of the QImage constructors taking a data pointer,
+     * and that buffer can be painted over or freed right after the call.
+     * Format_ARGB32, Format_ARGB32_Premultiplied, Format_RGB32 and
+     * Format_RGBA8888 are converted without intermediate copies.
+     *
+     * \sa setIconByPixmap()
+     *
+     * \since 6.29
+     */
+    void setIconByImage(const QImage &image);
+
     /*!
      * \brief Sets an icon to be used as overlay for the main one.
      *
@@ -537,6 +559,257 @@ public:
      */
     bool isMenu() const;
 
+    /*!
+     * \brief Sets the \a sizes pixmap icons are rasterized at before being
+     * sent to the host, once for each of the \a devicePixelRatios.
+     *
+     * By default scalable icons are rendered at 16, 22 and 32 pixels and
+     * bitmap icons are sent at every size they provide. Restricting this to
+     * the sizes the host actually draws, for instance 22 pixels at a device
+     * pixel ratio of 2 on a HiDPI panel, saves both rasterization and D-Bus
+     * bandwidth. The sizes asked for by hosts supporting the
+     * ProvideIconSizes() D-Bus method are rasterized in addition to these.
+     *
+     * Passing an empty list of \a sizes restores the default behavior.
+     *
+     * This has no effect on icons set by name.
+     *
+     * \sa iconPixmapSizes()
+     *
+     * \since 6.29
+     */
+    void setIconPixmapSizes(const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios = {1.0});
+
+    /*!
+     * \brief Returns the sizes set with setIconPixmapSizes(), or an empty list
+     * if the sizes provided by each icon are used.
+     *
+     * \sa setIconPixmapSizes()
+     *
+     * \since 6.29
+     */
+    QList<QSize> iconPixmapSizes() const;
+
+    /*!
+     * \brief Returns the device pixel ratios set with setIconPixmapSizes().
+     *
+     * \sa setIconPixmapSizes()
+     *
+     * \since 6.29
+     */
+    QList<qreal> iconPixmapDevicePixelRatios() const;
+
+    /*!
+     * \brief Sets whether pixmap icons are converted for the host on a worker thread.
+     *
+     * Hashing large icons and converting them to the format of the D-Bus
+     * protocol can stall the GUI thread for a noticeable time. When \a enabled,
+     * this work is done in the background, and the host is only told about a
+     * new icon once it is ready. A conversion still in progress is canceled
+     * when a newer icon replaces it.
+     *
+     * The icons are still rendered at the requested sizes in the GUI thread,
+     * as QIcon and the icon theme can only be used from there.
+     *
+     * Disabled by default.
+     *
+     * \since 6.29
+     */
+    void setAsynchronousIconSerialization(bool enabled);
+
+    /*!
+     * \brief Returns whether pixmap icons are converted on a worker thread.
+     *
+     * \sa setAsynchronousIconSerialization()
+     *
+     * \since 6.29
+     */
+    bool asynchronousIconSerialization() const;
+
+    /*!
+     * \brief Sets the minimum time, in \a msec, between two notifications
+     * sent to the host about changes of this item.
+     *
+     * Changes are always collected and announced at most once per kind per
+     * event loop iteration, so a burst of setter calls costs the host a
+     * single refresh. Items updated at a high rate, for instance a tooltip
+     * showing download progress, can additionally rate-limit the refreshes
+     * with this interval. The latest state is always announced eventually.
+     *
+     * The default is 0, announcing changes on the next event loop iteration.
+     *
+     * \sa minimumSignalInterval()
+     *
+     * \since 6.29
+     */
+    void setMinimumSignalInterval(int msec);
+
+    /*!
+     * \brief Returns the minimum time in milliseconds between two notifications
+     * sent to the host about changes of this item.
+     *
+     * \sa setMinimumSignalInterval()
+     *
+     * \since 6.29
+     */
+    int minimumSignalInterval() const;
+
+    /*!
+     * \brief Sets whether changes of this item are also announced to the host
+     * with org.freedesktop.DBus.Properties.PropertiesChanged.
+     *
+     * The signal carries the new values of the changed properties, such as
+     * the icon pixmaps or the tooltip, so hosts supporting it do not need to
+     * fetch them again after each change. The setting is advertised to hosts
+     * through the EmitsPropertiesChanged property of the item.
+     *
+     * Disabled by default.
+     *
+     * \sa propertiesChangedSignals()
+     *
+     * \since 6.29
+     */
+    void setPropertiesChangedSignals(bool enabled);
+
+    /*!
+     * \brief Returns whether changes of this item are also announced with
+     * org.freedesktop.DBus.Properties.PropertiesChanged.
+     *
+     * \sa setPropertiesChangedSignals()
+     *
+     * \since 6.29
+     */
+    bool propertiesChangedSignals() const;
+
+    /*!
+     * \brief Sets the maximum amount of memory, in \a bytes, used to share
+     * serialized pixmap icons between all the items of the application.
+     *
+     * Items using pixmaps with identical content, for instance because they
+     * represent several accounts of the same service, convert and store them
+     * only once. When the limit is exceeded the least recently used icons are
+     * dropped from the cache. The default limit is 8 MiB.
+     *
+     * \sa iconCacheLimit()
+     *
+     * \since 6.29
+     */
+    static void setIconCacheLimit(qsizetype bytes);
+
+    /*!
+     * \brief Returns the maximum amount of memory, in bytes, used to share
+     * serialized pixmap icons between all the items of the application.
+     *
+     * \sa setIconCacheLimit()
+     *
+     * \since 6.29
+     */
+    static qsizetype iconCacheLimit();
+
+    /*!
+     * \brief Sets whether items created afterwards share the session bus
+     * connection of the application.
+     *
+     * By default each item opens its own connection to the session bus, and
+     * is known to the host by the unique name of that connection. Applications
+     * showing many items can instead have them all use the session bus
+     * connection of the application, each at its own object path, which saves
+     * a connection and its setup per item. The host must accept items
+     * registered by object path, as the Plasma one does.
+     *
+     * Items already created keep their connection.
+     *
+     * Disabled by default.
+     *
+     * \sa sharedBusConnection()
+     *
+     * \since 6.29
+     */
+    static void setSharedBusConnection(bool shared);
+
+    /*!
+     * \brief Returns whether items created from now on share the session bus
+     * connection of the application.
+     *
+     * \sa setSharedBusConnection()
+     *
+     * \since 6.29
+     */
+    static bool sharedBusConnection();
+
+    /*!
+     * \brief Returns whether the item is currently registered with the
+     * StatusNotifierWatcher, and thus shown by the host.
+     *
+     * \sa registered(), registrationTime()
+     *
+     * \since 6.29
+     */
+    bool isRegistered() const;
+
+    /*!
+     * \brief Returns the time in milliseconds the last registration with the
+     * StatusNotifierWatcher took, or -1 if the item is not registered.
+     *
+     * The time is measured from the creation of the item, or from the moment
+     * the watcher appeared again on the bus, until it accepted the item. It
+     * tells how long it takes for the item to become visible.
+     *
+     * \sa registered()
+     *
+     * \since 6.29
+     */
+    qint64 registrationTime() const;
+
+    /*!
+     * \brief Starts a batch of changes to the item.
+     *
+     * Until the matching commitUpdate(), the setters only record the new
+     * values. Changing the icon, the overlay, the tooltip and the status
+     * together then converts each changed pixmap icon once, and notifies the
+     * host about all of them in a single round of signals, instead of once
+     * per setter.
+     *
+     * Calls can be nested, the changes are committed by the outermost
+     * commitUpdate().
+     *
+     * \code
+     * item->beginUpdate();
+     * item->setIconByPixmap(busyIcon);
+     * item->setToolTipSubTitle(i18n("Syncing…"));
+     * item->setStatus(KStatusNotifierItem::Active);
+     * item->commitUpdate();
+     * \endcode
+     *
+     * \sa commitUpdate()
+     *
+     * \since 6.29
+     */
+    void beginUpdate();
+
+    /*!
+     * \brief Ends a batch of changes started with beginUpdate(), and
+     * announces what changed to the host.
+     *
+     * \sa beginUpdate()
+     *
+     * \since 6.29
+     */
+    void commitUpdate();
+
+    /*!
+     * \brief Returns how many pixmap icon updates were not sent to the host
+     * because the new icon had exactly the same pixels as the previous one.
+     *
+     * Applications recreating their QIcon on a timer, or setting the same
+     * image again, do not cause any D-Bus traffic in that case.
+     *
+     * \sa setIconByPixmap(), setIconByImage()
+     *
+     * \since 6.29
+     */
+    quint64 suppressedIconUpdates() const;
+
 public Q_SLOTS:
 
     /*!
@@ -604,6 +877,16 @@ Q_SIGNALS:
      */
     void quitRequested();
 
+    /*!
+     * \brief Emitted when the StatusNotifierWatcher accepted the item,
+     * after its creation or after the watcher appeared again on the bus.
+     *
+     * \sa isRegistered(), registrationTime()
+     *
+     * \since 6.29
+     */
+    void registered();
+
 protected:
     bool eventFilter(QObject *watched, QEvent *event) override;
 
@@ -10,11 +10,17 @@
 #include "kstatusnotifieritem.h"
 #include "kstatusnotifieritemprivate_p.h"
 
+#include <QDBusMessage>
+#include <QDBusServiceWatcher>
 #include <QMenu>
+#include <QPromise>
+#include <QThread>
+#include <QThreadPool>
 
-#include <kwindowsystem.h>
+#include <algorithm>
+#include <utility>
 
-#include "statusnotifierwatcher_interface.h"
+#include <kwindowsystem.h>
 
 #include "statusnotifieritemadaptor.h"
 
@@ -31,6 +37,38 @@ __inline int toInt(WId wid)
 }
 #endif
 
+// The names of the enumerators as sent over the bus, the specification
+// spells them like the C++ ones
+static constexpr QLatin1StringView categoryName(KStatusNotifierItem::ItemCategory category)
+{
+    switch (category) {
+    case KStatusNotifierItem::ApplicationStatus:
+        return QLatin1StringView("ApplicationStatus");
+    case KStatusNotifierItem::Communications:
+        return QLatin1StringView("Communications");
+    case KStatusNotifierItem::SystemServices:
+        return QLatin1StringView("SystemServices");
+    case KStatusNotifierItem::Hardware:
+        return QLatin1StringView("Hardware");
+    case KStatusNotifierItem::Reserved:
+        return QLatin1StringView("Reserved");
+    }
+    return QLatin1StringView();
+}
+
+static constexpr QLatin1StringView statusName(KStatusNotifierItem::ItemStatus status)
+{
+    switch (status) {
+    case KStatusNotifierItem::Passive:
+        return QLatin1StringView("Passive");
+    case KStatusNotifierItem::Active:
+        return QLatin1StringView("Active");
+    case KStatusNotifierItem::NeedsAttention:
+        return QLatin1StringView("NeedsAttention");
+    }
+    return QLatin1StringView();
+}
+
 // Marshall the ImageStruct data into a D-BUS argument
 const QDBusArgument &operator<<(QDBusArgument &argument, const KDbusImageStruct &icon)
 {
@@ -126,24 +164,134 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, KDbusToolTipStruc
 }
 
 int KStatusNotifierItemDBus::s_serviceCount = 0;
+bool KStatusNotifierItemDBus::s_sharedConnection = false;
+
+static QThread *s_dbusThread = nullptr;
+
+// The thread all items answer the bus from
+static QThread *dbusThread()
+{
+    if (!s_dbusThread) {
+        s_dbusThread = new QThread;
+        s_dbusThread->setObjectName(QStringLiteral("KStatusNotifierItem D-Bus"));
+        s_dbusThread->start();
+        qAddPostRoutine([] {
+            s_dbusThread->quit();
+            s_dbusThread->wait();
+            delete s_dbusThread;
+            s_dbusThread = nullptr;
+        });
+    }
+    return s_dbusThread;
+}
+
+static QThreadPool *s_connectionPool = nullptr;
 
-KStatusNotifierItemDBus::KStatusNotifierItemDBus(KStatusNotifierItem *parent)
-    : QObject(parent)
-    , m_statusNotifierItem(parent)
+// Connects the items to the bus. Not the global pool, which the application
+// may keep busy with its own work, while the item waits to show up.
+static QThreadPool *connectionPool()
+{
+    if (!s_connectionPool) {
+        s_connectionPool = new QThreadPool;
+        s_connectionPool->setObjectName(QStringLiteral("KStatusNotifierItem connection"));
+        s_connectionPool->setMaxThreadCount(1);
+        qAddPostRoutine([] {
+            delete s_connectionPool;
+            s_connectionPool = nullptr;
+        });
+    }
+    return s_connectionPool;
+}
+
+KStatusNotifierItemDBus::KStatusNotifierItemDBus(KStatusNotifierItem *item)
+    : QObject(nullptr)
+    , m_statusNotifierItem(item)
     , m_connId(QStringLiteral("org.kde.StatusNotifierItem-%1-%2").arg(QCoreApplication::applicationPid()).arg(++s_serviceCount))
     , m_dbus(QDBusConnection(m_connId))
-{
-    m_dbus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, m_connId);
+    , m_shared(s_sharedConnection)
+    , m_signalTimer(new QTimer(item))
+    , m_snapshot(std::make_shared<KStatusNotifierItemSnapshot>())
+{
+    if (m_shared) {
+        // all items live on the session bus connection of the application,
+        // told apart by their object path
+        m_objectPath = QStringLiteral("/StatusNotifierItem/%1").arg(s_serviceCount);
+        m_menuObjectPath = QStringLiteral("/MenuBar/%1").arg(s_serviceCount);
+    } else {
+        m_objectPath = QStringLiteral("/StatusNotifierItem");
+        m_menuObjectPath = QStringLiteral("/MenuBar");
+    }
+
+    m_signalTimer->setSingleShot(true);
+    connect(m_signalTimer, &QTimer::timeout, item, [this]() {
+        flushChanges();
+    });
 
     new StatusNotifierItemAdaptor(this);
-    qCDebug(LOG_KSTATUSNOTIFIERITEM) << "service is" << m_connId;
-    m_dbus.registerObject(QStringLiteral("/StatusNotifierItem"), this);
+
+    // the authentication handshake and the Hello call can take a while on a busy
+    // bus, so connect from a worker thread and finish the setup once connected
+    auto promise = std::make_shared<QPromise<void>>();
+    m_connectionJob = promise->future();
+    connectionPool()->start([promise, shared = m_shared, connId = m_connId]() {
+        promise->start();
+        if (shared) {
+            QDBusConnection::sessionBus();
+        } else {
+            QDBusConnection::connectToBus(QDBusConnection::SessionBus, connId);
+        }
+        promise->finish();
+    });
+    m_connectionJob.then(item, [this]() {
+        connectionEstablished();
+    });
+
+    moveToThread(dbusThread());
+}
+
+KStatusNotifierItemDBus::~KStatusNotifierItemDBus() = default;
+
+void KStatusNotifierItemDBus::detach()
+{
+    m_signalTimer->stop();
+
+    // the connection must exist before it can be closed again
+    m_connectionJob.waitForFinished();
+
+    m_dbus.unregisterObject(m_objectPath);
+    if (!m_shared) {
+        QDBusConnection::disconnectFromBus(m_connId);
+    }
+
+    QMutexLocker locker(&m_itemMutex);
+    m_statusNotifierItem = nullptr;
+}
+
+void KStatusNotifierItemDBus::connectionEstablished()
+{
+    m_dbus = m_shared ? QDBusConnection::sessionBus() : QDBusConnection(m_connId);
+    m_connected = true;
+
+    // the icons are only converted once the item is registered, see
+    // KStatusNotifierItemPrivate::registrationSucceeded()
+    publishSnapshot();
+
+    qCDebug(LOG_KSTATUSNOTIFIERITEM) << "service is" << service() << "at" << m_objectPath;
+    m_dbus.registerObject(m_objectPath, this);
+
+    const QList<std::function<void()>> pendingCalls = std::exchange(m_pendingCalls, {});
+    for (const auto &function : pendingCalls) {
+        function();
+    }
 }
 
-KStatusNotifierItemDBus::~KStatusNotifierItemDBus()
+void KStatusNotifierItemDBus::whenConnected(const std::function<void()> &function)
 {
-    m_dbus.unregisterObject(QStringLiteral("/StatusNotifierItem"));
-    m_dbus.disconnectFromBus(m_connId);
+    if (m_connected) {
+        function();
+    } else {
+        m_pendingCalls.append(function);
+    }
 }
 
 QDBusConnection KStatusNotifierItemDBus::dbusConnection() const
@@ -156,145 +304,451 @@ QString KStatusNotifierItemDBus::service() const
     return m_dbus.baseService();
 }
 
+QString KStatusNotifierItemDBus::objectPath() const
+{
+    return m_objectPath;
+}
+
+QString KStatusNotifierItemDBus::menuObjectPath() const
+{
+    return m_menuObjectPath;
+}
+
+QString KStatusNotifierItemDBus::registrationName() const
+{
+    // the watcher takes an object path as the item of the connection the
+    // registration comes from, which is the session bus one in shared mode
+    return m_shared ? m_objectPath : service();
+}
+
+void KStatusNotifierItemDBus::setSharedConnection(bool shared)
+{
+    s_sharedConnection = shared;
+}
+
+bool KStatusNotifierItemDBus::sharedConnection()
+{
+    return s_sharedConnection;
+}
+
+void KStatusNotifierItemDBus::scheduleChangeSignal(ChangeSignal signal)
+{
+    m_pendingSignals |= signal;
+    startFlushTimer();
+}
+
+void KStatusNotifierItemDBus::invalidateSnapshot()
+{
+    startFlushTimer();
+}
+
+void KStatusNotifierItemDBus::releaseChanges()
+{
+    if (std::exchange(m_changesHeld, false)) {
+        startFlushTimer();
+    }
+}
+
+void KStatusNotifierItemDBus::startFlushTimer()
+{
+    if (m_statusNotifierItem->d->updateDepth > 0) {
+        m_changesHeld = true;
+        return;
+    }
+    if (m_signalTimer->isActive()) {
+        return;
+    }
+
+    qint64 delay = 0;
+    const int interval = m_statusNotifierItem->minimumSignalInterval();
+    if (interval > 0 && m_lastSignalTime.isValid()) {
+        delay = qMax<qint64>(0, interval - m_lastSignalTime.elapsed());
+    }
+    m_signalTimer->start(int(delay));
+}
+
+void KStatusNotifierItemDBus::flushChanges()
+{
+    if (m_statusNotifierItem->d->updateDepth > 0) {
+        // the batch spans several event loop iterations, wait for its end
+        m_changesHeld = true;
+        return;
+    }
+
+    ChangeSignals pending = std::exchange(m_pendingSignals, {});
+    if (!m_connected) {
+        // no host knows about the item yet, it reads the current state on registration
+        return;
+    }
+
+    // pixmap icons are converted once per flush while a host is there to
+    // read them, and not announced at all when no pixel changed
+    pending |= m_statusNotifierItem->d->serializeChangedIcons();
+
+    // the host reads the new values as soon as it got the signals
+    publishSnapshot();
+
+    if (pending) {
+        m_lastSignalTime.start();
+        QMetaObject::invokeMethod(
+            this,
+            [this, pending]() {
+                emitChangeSignals(pending);
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void KStatusNotifierItemDBus::publishSnapshot()
+{
+    KStatusNotifierItem *item = m_statusNotifierItem;
+    KStatusNotifierItemPrivate *d = item->d.get();
+
+    // only the GUI thread replaces the snapshot, no need to lock for reading it here
+    auto snapshot = m_snapshot ? std::make_shared<KStatusNotifierItemSnapshot>(*m_snapshot) : std::make_shared<KStatusNotifierItemSnapshot>();
+    snapshot->category = QString(categoryName(item->category()));
+    snapshot->id = item->id();
+    snapshot->title = item->title();
+    snapshot->status = QString(statusName(item->status()));
+    snapshot->windowId = toInt(d->associatedWindowId);
+    snapshot->itemIsMenu = item->isMenu();
+    snapshot->emitsPropertiesChanged = item->propertiesChangedSignals();
+    snapshot->iconName = item->iconName();
+    snapshot->overlayIconName = item->overlayIconName();
+    snapshot->attentionIconName = item->attentionIconName();
+    snapshot->attentionMovieName = d->movieName;
+    snapshot->toolTip.icon = item->toolTipIconName();
+    snapshot->toolTip.title = item->toolTipTitle();
+    snapshot->toolTip.subTitle = item->toolTipSubTitle();
+    snapshot->iconThemePath = d->iconThemePath;
+    snapshot->menu = QDBusObjectPath(d->menuObjectPath);
+
+    // the icons were converted by serializeChangedIcons() already, only the
+    // ones converted since the previous snapshot need to be picked up
+    m_publishedIconRevisions.resize(KStatusNotifierItemPrivate::IconRoleCount);
+    for (int i = 0; i < KStatusNotifierItemPrivate::IconRoleCount; ++i) {
+        const auto role = KStatusNotifierItemPrivate::IconRole(i);
+        const quint64 revision = d->serializedIcons[role].revision;
+        if (std::exchange(m_publishedIconRevisions[role], revision) == revision) {
+            continue;
+        }
+
+        const KDbusImageVector &vector = d->serializedIcon(role);
+        switch (role) {
+        case KStatusNotifierItemPrivate::MainIcon:
+            snapshot->iconPixmap = vector;
+            break;
+        case KStatusNotifierItemPrivate::OverlayIcon:
+            snapshot->overlayIconPixmap = vector;
+            break;
+        case KStatusNotifierItemPrivate::AttentionIcon:
+            snapshot->attentionIconPixmap = vector;
+            break;
+        case KStatusNotifierItemPrivate::ToolTipIcon:
+            snapshot->toolTip.image = vector;
+            break;
+        case KStatusNotifierItemPrivate::IconRoleCount:
+            break;
+        }
+    }
+
+    QMutexLocker locker(&m_snapshotMutex);
+    m_snapshot = std::move(snapshot);
+}
+
+std::shared_ptr<const KStatusNotifierItemSnapshot> KStatusNotifierItemDBus::snapshot() const
+{
+    QMutexLocker locker(&m_snapshotMutex);
+    return m_snapshot;
+}
+
+template<typename Function>
+void KStatusNotifierItemDBus::forwardToItem(Function function)
+{
+    // events posted to the item are dropped when it is deleted, so it only
+    // has to be alive at the time of posting
+    QMutexLocker locker(&m_itemMutex);
+    if (KStatusNotifierItem *item = m_statusNotifierItem) {
+        QMetaObject::invokeMethod(
+            item,
+            [item, function = std::move(function)]() {
+                function(item);
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void KStatusNotifierItemDBus::emitChangeSignals(ChangeSignals changes)
+{
+    if (changes & IconChanged) {
+        Q_EMIT NewIcon();
+    }
+    if (changes & OverlayIconChanged) {
+        Q_EMIT NewOverlayIcon();
+    }
+    if (changes & AttentionIconChanged) {
+        Q_EMIT NewAttentionIcon();
+    }
+    if (changes & MenuChanged) {
+        Q_EMIT NewMenu();
+    }
+    if (changes & ToolTipChanged) {
+        Q_EMIT NewToolTip();
+    }
+    if (changes & StatusChanged) {
+        Q_EMIT NewStatus(Status());
+    }
+
+    if (EmitsPropertiesChanged()) {
+        emitPropertiesChanged(changes);
+    }
+}
+
+void KStatusNotifierItemDBus::emitPropertiesChanged(ChangeSignals changes)
+{
+    const std::shared_ptr<const KStatusNotifierItemSnapshot> state = snapshot();
+
+    QVariantMap properties;
+    if (changes & IconChanged) {
+        properties.insert(QStringLiteral("IconName"), state->iconName);
+        properties.insert(QStringLiteral("IconPixmap"), QVariant::fromValue(state->iconPixmap));
+    }
+    if (changes & OverlayIconChanged) {
+        properties.insert(QStringLiteral("OverlayIconName"), state->overlayIconName);
+        properties.insert(QStringLiteral("OverlayIconPixmap"), QVariant::fromValue(state->overlayIconPixmap));
+    }
+    if (changes & AttentionIconChanged) {
+        properties.insert(QStringLiteral("AttentionIconName"), state->attentionIconName);
+        properties.insert(QStringLiteral("AttentionIconPixmap"), QVariant::fromValue(state->attentionIconPixmap));
+        properties.insert(QStringLiteral("AttentionMovieName"), state->attentionMovieName);
+    }
+    if (changes & MenuChanged) {
+        properties.insert(QStringLiteral("Menu"), QVariant::fromValue(state->menu));
+    }
+    if (changes & ToolTipChanged) {
+        properties.insert(QStringLiteral("ToolTip"), QVariant::fromValue(state->toolTip));
+    }
+    if (changes & StatusChanged) {
+        properties.insert(QStringLiteral("Status"), state->status);
+    }
+
+    QDBusMessage message = QDBusMessage::createSignal(m_objectPath,
+                                                      QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                      QStringLiteral("PropertiesChanged"));
+    message << QStringLiteral("org.kde.StatusNotifierItem") << properties << QStringList();
+    m_dbus.send(message);
+}
+
 bool KStatusNotifierItemDBus::ItemIsMenu() const
 {
-    return m_statusNotifierItem->isMenu();
+    return snapshot()->itemIsMenu;
+}
+
+bool KStatusNotifierItemDBus::EmitsPropertiesChanged() const
+{
+    return snapshot()->emitsPropertiesChanged;
 }
 
 // DBUS slots
 
 QString KStatusNotifierItemDBus::Category() const
 {
-    return QLatin1String(m_statusNotifierItem->metaObject()
-                             ->enumerator(m_statusNotifierItem->metaObject()->indexOfEnumerator("ItemCategory"))
-                             .valueToKey(m_statusNotifierItem->category()));
+    return snapshot()->category;
 }
 
 QString KStatusNotifierItemDBus::Title() const
 {
-    return m_statusNotifierItem->title();
+    return snapshot()->title;
 }
 
 QString KStatusNotifierItemDBus::Id() const
 {
-    return m_statusNotifierItem->id();
+    return snapshot()->id;
 }
 
 QString KStatusNotifierItemDBus::Status() const
 {
-    return QLatin1String(m_statusNotifierItem->metaObject()
-                             ->enumerator(m_statusNotifierItem->metaObject()->indexOfEnumerator("ItemStatus"))
-                             .valueToKey(m_statusNotifierItem->status()));
+    return snapshot()->status;
 }
 
 int KStatusNotifierItemDBus::WindowId() const
 {
-    if (m_statusNotifierItem->d->associatedWindow) {
-        return toInt(m_statusNotifierItem->d->associatedWindow->winId());
-    } else {
-        return 0;
-    }
+    return snapshot()->windowId;
 }
 
 // Icon
 
 QString KStatusNotifierItemDBus::IconName() const
 {
-    return m_statusNotifierItem->iconName();
+    return snapshot()->iconName;
 }
 
 KDbusImageVector KStatusNotifierItemDBus::IconPixmap() const
 {
-    return m_statusNotifierItem->d->serializedIcon;
+    return snapshot()->iconPixmap;
 }
 
 QString KStatusNotifierItemDBus::OverlayIconName() const
 {
-    return m_statusNotifierItem->overlayIconName();
+    return snapshot()->overlayIconName;
 }
 
 KDbusImageVector KStatusNotifierItemDBus::OverlayIconPixmap() const
 {
-    return m_statusNotifierItem->d->serializedOverlayIcon;
+    return snapshot()->overlayIconPixmap;
 }
 
 // Requesting attention icon and movie
 
 QString KStatusNotifierItemDBus::AttentionIconName() const
 {
-    return m_statusNotifierItem->attentionIconName();
+    return snapshot()->attentionIconName;
 }
 
 KDbusImageVector KStatusNotifierItemDBus::AttentionIconPixmap() const
 {
-    return m_statusNotifierItem->d->serializedAttentionIcon;
+    return snapshot()->attentionIconPixmap;
 }
 
 QString KStatusNotifierItemDBus::AttentionMovieName() const
 {
-    return m_statusNotifierItem->d->movieName;
+    return snapshot()->attentionMovieName;
 }
 
 // ToolTip
 
 KDbusToolTipStruct KStatusNotifierItemDBus::ToolTip() const
 {
-    KDbusToolTipStruct toolTip;
-    toolTip.icon = m_statusNotifierItem->toolTipIconName();
-    toolTip.image = m_statusNotifierItem->d->serializedToolTipIcon;
-    toolTip.title = m_statusNotifierItem->toolTipTitle();
-    toolTip.subTitle = m_statusNotifierItem->toolTipSubTitle();
-
-    return toolTip;
+    return snapshot()->toolTip;
 }
 
 QString KStatusNotifierItemDBus::IconThemePath() const
 {
-    return m_statusNotifierItem->d->iconThemePath;
+    return snapshot()->iconThemePath;
 }
 
 // Menu
 QDBusObjectPath KStatusNotifierItemDBus::Menu() const
 {
-    return QDBusObjectPath(m_statusNotifierItem->d->menuObjectPath);
+    return snapshot()->menu;
 }
 
-// Interaction
+// Interaction, handled in the GUI thread
 
 void KStatusNotifierItemDBus::ContextMenu(int x, int y)
 {
-    if (!m_statusNotifierItem->d->menu) {
-        return;
-    }
+    forwardToItem([x, y](KStatusNotifierItem *item) {
+        QMenu *menu = item->d->menu;
+        if (!menu) {
+            return;
+        }
 
-    // TODO: nicer placement, possible?
-    if (!m_statusNotifierItem->d->menu->isVisible()) {
-        m_statusNotifierItem->d->menu->popup(QPoint(x, y));
-    } else {
-        m_statusNotifierItem->d->menu->hide();
-    }
+        // TODO: nicer placement, possible?
+        if (!menu->isVisible()) {
+            menu->popup(QPoint(x, y));
+        } else {
+            menu->hide();
+        }
+    });
 }
 
 void KStatusNotifierItemDBus::Activate(int x, int y)
 {
-    m_statusNotifierItem->activate(QPoint(x, y));
+    forwardToItem([x, y](KStatusNotifierItem *item) {
+        item->activate(QPoint(x, y));
+    });
 }
 
 void KStatusNotifierItemDBus::SecondaryActivate(int x, int y)
 {
-    Q_EMIT m_statusNotifierItem->secondaryActivateRequested(QPoint(x, y));
+    forwardToItem([x, y](KStatusNotifierItem *item) {
+        Q_EMIT item->secondaryActivateRequested(QPoint(x, y));
+    });
 }
 
 void KStatusNotifierItemDBus::Scroll(int delta, const QString &orientation)
 {
     Qt::Orientation dir = (orientation.toLower() == QLatin1String("horizontal") ? Qt::Horizontal : Qt::Vertical);
-    Q_EMIT m_statusNotifierItem->scrollRequested(delta, dir);
+    forwardToItem([delta, dir](KStatusNotifierItem *item) {
+        Q_EMIT item->scrollRequested(delta, dir);
+    });
 }
 
 void KStatusNotifierItemDBus::ProvideXdgActivationToken(const QString &token)
 {
-    m_xdgActivationToken = token;
-    KWindowSystem::setCurrentXdgActivationToken(token);
+    forwardToItem([token](KStatusNotifierItem *item) {
+        item->d->statusNotifierItemDBus->m_xdgActivationToken = token;
+        KWindowSystem::setCurrentXdgActivationToken(token);
+    });
+}
+
+void KStatusNotifierItemDBus::ProvideIconSizes(const QList<int> &sizes, const QList<double> &scales)
+{
+    // ignore nonsense, a misbehaving host should not make us render huge pixmaps
+    QList<QSize> iconSizes;
+    for (int size : sizes) {
+        if (size > 0 && size <= 256) {
+            iconSizes.append(QSize(size, size));
+        }
+    }
+
+    QList<qreal> devicePixelRatios;
+    for (double scale : scales) {
+        if (scale > 0 && scale <= 4) {
+            devicePixelRatios.append(scale);
+        }
+    }
+
+    if (devicePixelRatios.isEmpty()) {
+        devicePixelRatios.append(1.0);
+    }
+
+    // several hosts may show the item, each one replaces only its own sizes
+    const QString host = calledFromDBus() ? message().service() : QString();
+    if (!m_hostWatcher) {
+        m_hostWatcher = new QDBusServiceWatcher(QString(), m_dbus, QDBusServiceWatcher::WatchForUnregistration, this);
+        connect(m_hostWatcher, &QDBusServiceWatcher::serviceUnregistered, this, [this](const QString &service) {
+            m_hostWatcher->removeWatchedService(service);
+            if (m_hostIconSizes.remove(service)) {
+                hostIconSizesChanged();
+            }
+        });
+    }
+    if (!host.isEmpty() && !m_hostIconSizes.contains(host)) {
+        m_hostWatcher->addWatchedService(host);
+    }
+    m_hostIconSizes.insert(host, {iconSizes, devicePixelRatios});
+    hostIconSizesChanged();
+}
+
+void KStatusNotifierItemDBus::hostIconSizesChanged()
+{
+    QList<QSize> iconSizes;
+    QList<qreal> devicePixelRatios;
+    for (const auto &[sizes, ratios] : std::as_const(m_hostIconSizes)) {
+        for (QSize size : sizes) {
+            if (!iconSizes.contains(size)) {
+                iconSizes.append(size);
+            }
+        }
+        for (qreal ratio : ratios) {
+            if (!devicePixelRatios.contains(ratio)) {
+                devicePixelRatios.append(ratio);
+            }
+        }
+    }
+
+    // independent of the order the hosts called in, so that nothing gets
+    // rasterized again when the union did not change
+    std::sort(iconSizes.begin(), iconSizes.end(), [](QSize a, QSize b) {
+        return a.width() < b.width() || (a.width() == b.width() && a.height() < b.height());
+    });
+    std::sort(devicePixelRatios.begin(), devicePixelRatios.end());
+
+    // the last host leaving restores the sizes set by the application
+    forwardToItem([iconSizes, devicePixelRatios](KStatusNotifierItem *item) {
+        item->d->setHostIconPixmapSizes(iconSizes, devicePixelRatios);
+    });
 }
 
 #include "moc_kstatusnotifieritemdbus_p.cpp"
@@ -10,10 +10,20 @@
 
 #include <QDBusArgument>
 #include <QDBusConnection>
+#include <QDBusContext>
 #include <QDBusObjectPath>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QObject>
+#include <QSize>
 #include <QString>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
 
 // Custom message type for DBus
 struct KDbusImageStruct {
@@ -31,9 +41,40 @@ struct KDbusToolTipStruct {
     QString subTitle;
 };
 
+// The state of an item as served over the bus. Published by the GUI thread
+// whenever the item changed, and only read afterwards.
+struct KStatusNotifierItemSnapshot {
+    QString category;
+    QString id;
+    QString title;
+    QString status;
+    int windowId = 0;
+    bool itemIsMenu = false;
+    bool emitsPropertiesChanged = false;
+    QString iconName;
+    KDbusImageVector iconPixmap;
+    QString overlayIconName;
+    KDbusImageVector overlayIconPixmap;
+    QString attentionIconName;
+    KDbusImageVector attentionIconPixmap;
+    QString attentionMovieName;
+    KDbusToolTipStruct toolTip;
+    QString iconThemePath;
+    QDBusObjectPath menu;
+};
+
 class KStatusNotifierItem;
+class QDBusServiceWatcher;
 
-class KStatusNotifierItemDBus : public QObject
+/*
+ * The item as seen on the bus.
+ *
+ * The object lives in a thread shared by all items, so that hosts reading
+ * properties are answered from the latest published snapshot even while the
+ * GUI thread is busy. Interaction requests from the host are forwarded to the
+ * GUI thread. Everything else is called from the GUI thread.
+ */
+class KStatusNotifierItemDBus : public QObject, protected QDBusContext
 {
     Q_OBJECT
 
@@ -43,6 +84,7 @@ class KStatusNotifierItemDBus : public QObject
     Q_PROPERTY(QString Status READ Status)
     Q_PROPERTY(int WindowId READ WindowId)
     Q_PROPERTY(bool ItemIsMenu READ ItemIsMenu)
+    Q_PROPERTY(bool EmitsPropertiesChanged READ EmitsPropertiesChanged)
     Q_PROPERTY(QString IconName READ IconName)
     Q_PROPERTY(KDbusImageVector IconPixmap READ IconPixmap)
     Q_PROPERTY(QString OverlayIconName READ OverlayIconName)
@@ -57,19 +99,84 @@ class KStatusNotifierItemDBus : public QObject
     friend class KStatusNotifierItem;
 
 public:
-    explicit KStatusNotifierItemDBus(KStatusNotifierItem *parent);
+    enum ChangeSignal {
+        IconChanged = 0x01,
+        OverlayIconChanged = 0x02,
+        AttentionIconChanged = 0x04,
+        MenuChanged = 0x08,
+        ToolTipChanged = 0x10,
+        StatusChanged = 0x20,
+    };
+    Q_DECLARE_FLAGS(ChangeSignals, ChangeSignal)
+
+    explicit KStatusNotifierItemDBus(KStatusNotifierItem *item);
     ~KStatusNotifierItemDBus() override;
 
+    /**
+     * Takes the item off the bus and stops forwarding requests to it. To be
+     * called from the GUI thread before the item goes away, the object is
+     * then deleted with deleteLater().
+     */
+    void detach();
+
+    /**
+     * Queue the D-Bus signal announcing @p signal. Queued signals are sent
+     * once per kind on the next event loop iteration, or once the minimum
+     * signal interval of the item has passed since the last ones were sent.
+     */
+    void scheduleChangeSignal(ChangeSignal signal);
+
+    /**
+     * Publishes a new snapshot of the item on the next event loop iteration,
+     * for changes that come without a signal
+     */
+    void invalidateSnapshot();
+
+    /**
+     * Sends the changes held back while the item was in the middle of a
+     * batched update, see KStatusNotifierItem::beginUpdate()
+     */
+    void releaseChanges();
+
     /**
      * @return the dbus connection used by this object
      */
     QDBusConnection dbusConnection() const;
 
+    /**
+     * Calls @p function once the connection to the bus is established,
+     * right away if it already is
+     */
+    void whenConnected(const std::function<void()> &function);
+
     /**
      * @return the service this object is registered on the bus under
      */
     QString service() const;
 
+    /**
+     * @return the object path this object is registered at
+     */
+    QString objectPath() const;
+
+    /**
+     * @return the object path the context menu is exported at
+     */
+    QString menuObjectPath() const;
+
+    /**
+     * @return the name to register this item with at the watcher, the
+     * service in the default mode, the object path with a shared connection
+     */
+    QString registrationName() const;
+
+    /**
+     * Makes the items created afterwards share the session bus connection
+     * of the application instead of opening one connection each
+     */
+    static void setSharedConnection(bool shared);
+    static bool sharedConnection();
+
     /**
      * @return the category of the application associated to this item
      * @see Category
@@ -102,6 +209,12 @@ public:
      */
     bool ItemIsMenu() const;
 
+    /**
+     * @return whether changes are also announced with PropertiesChanged,
+     * carrying the new values of the changed properties
+     */
+    bool EmitsPropertiesChanged() const;
+
     /**
      * @return the name of the main icon to be displayed
      * if image() is not empty this will always return an empty string
@@ -187,6 +300,16 @@ public Q_SLOTS:
      */
     void ProvideXdgActivationToken(const QString &token);
 
+    /**
+     * Inform this item of the pixel @p sizes the host draws the icons at,
+     * for each of the given device pixel ratios in @p scales, so pixmap icons
+     * are only rasterized at those sizes.
+     *
+     * The sizes are kept per calling host, and the icons rasterized at the
+     * sizes of all of them.
+     */
+    void ProvideIconSizes(const QList<int> &sizes, const QList<double> &scales);
+
 Q_SIGNALS:
     /**
      * Inform the systemtray that the own main icon has been changed,
@@ -222,13 +345,53 @@ Q_SIGNALS:
     void NewStatus(const QString &status);
 
 private:
+    void connectionEstablished();
+    void startFlushTimer();
+    void flushChanges();
+    void publishSnapshot();
+    std::shared_ptr<const KStatusNotifierItemSnapshot> snapshot() const;
+    void emitChangeSignals(ChangeSignals changes);
+    void emitPropertiesChanged(ChangeSignals changes);
+    void hostIconSizesChanged();
+    // calls function with the item in the GUI thread, unless it is gone
+    template<typename Function>
+    void forwardToItem(Function function);
+
+    // only changed by the GUI thread, under m_itemMutex
     KStatusNotifierItem *m_statusNotifierItem;
+    mutable QMutex m_itemMutex;
     QString m_connId;
     QString m_xdgActivationToken;
     QDBusConnection m_dbus;
+    QString m_objectPath;
+    QString m_menuObjectPath;
+    bool m_shared;
+    bool m_connected = false;
+    QFuture<void> m_connectionJob;
+    QList<std::function<void()>> m_pendingCalls;
+    ChangeSignals m_pendingSignals;
+    // lives in the GUI thread, as a child of the item
+    QTimer *m_signalTimer;
+    QElapsedTimer m_lastSignalTime;
+    // changes were made during a batched update of the item
+    bool m_changesHeld = false;
+
+    // replaced as a whole, readers keep the one they got alive as long as they need it
+    mutable QMutex m_snapshotMutex;
+    std::shared_ptr<const KStatusNotifierItemSnapshot> m_snapshot;
+    // sizes asked for through ProvideIconSizes(), by the unique name of the
+    // host, only used in the D-Bus thread
+    QHash<QString, std::pair<QList<QSize>, QList<qreal>>> m_hostIconSizes;
+    QDBusServiceWatcher *m_hostWatcher = nullptr;
+
+    // revision of each serialized icon in m_snapshot, by icon role
+    QList<quint64> m_publishedIconRevisions;
     static int s_serviceCount;
+    static bool s_sharedConnection;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(KStatusNotifierItemDBus::ChangeSignals)
+
 const QDBusArgument &operator<<(QDBusArgument &argument, const KDbusImageStruct &icon);
 const QDBusArgument &operator>>(const QDBusArgument &argument, KDbusImageStruct &icon);
 
@@ -0,0 +1,380 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kstatusnotifieritemimage_p.h"
+
+#include <QHashFunctions>
+#include <QMutexLocker>
+#include <QRgb>
+#include <QtEndian>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define KSNI_HAVE_SSE2 1
+#if defined(__GNUC__) && !defined(__AVX2__)
+// built for baseline x86-64, pick the AVX2 kernel at runtime
+#include <immintrin.h>
+#define KSNI_HAVE_AVX2_DISPATCH 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define KSNI_HAVE_AVX2 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KSNI_HAVE_NEON 1
+#endif
+
+namespace
+{
+// big endian hosts already have the pixels in network byte order
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+void copySwapScalar(quint32 *dst, const quint32 *src, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        dst[i] = qToBigEndian(src[i]);
+    }
+}
+
+#if defined(KSNI_HAVE_SSE2)
+qsizetype copySwapSse2(quint32 *dst, const quint32 *src, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        // swap the bytes of each 16 bit word, then the words of each pixel
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    return i;
+}
+#endif
+
+#if defined(KSNI_HAVE_AVX2) || defined(KSNI_HAVE_AVX2_DISPATCH)
+#if defined(KSNI_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+#endif
+qsizetype copySwapAvx2(quint32 *dst, const quint32 *src, qsizetype count)
+{
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, //
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+#endif
+
+#if defined(KSNI_HAVE_AVX2_DISPATCH)
+bool cpuHasAvx2()
+{
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+#endif
+
+#if defined(KSNI_HAVE_NEON)
+qsizetype copySwapNeon(quint32 *dst, const quint32 *src, qsizetype count)
+{
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), vrev32q_u8(v));
+    }
+    return i;
+}
+#endif
+#endif
+}
+
+QList<KStatusNotifierItemImage::ByteOrderKernel> KStatusNotifierItemImage::byteOrderKernels()
+{
+    QList<ByteOrderKernel> kernels;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#if defined(KSNI_HAVE_SSE2)
+    kernels.append({"SSE2", copySwapSse2});
+#endif
+#if defined(KSNI_HAVE_AVX2)
+    kernels.append({"AVX2", copySwapAvx2});
+#elif defined(KSNI_HAVE_AVX2_DISPATCH)
+    if (cpuHasAvx2()) {
+        kernels.append({"AVX2", copySwapAvx2});
+    }
+#endif
+#if defined(KSNI_HAVE_NEON)
+    kernels.append({"NEON", copySwapNeon});
+#endif
+#endif
+    return kernels;
+}
+
+void KStatusNotifierItemImage::copyToNetworkByteOrder(quint32 *dst, const quint32 *src, qsizetype count)
+{
+    if (count <= 0) {
+        return;
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    std::memcpy(dst, src, count * sizeof(quint32));
+#else
+    qsizetype done = 0;
+#if defined(KSNI_HAVE_AVX2)
+    done = copySwapAvx2(dst, src, count);
+#elif defined(KSNI_HAVE_AVX2_DISPATCH)
+    if (cpuHasAvx2()) {
+        done = copySwapAvx2(dst, src, count);
+    }
+#endif
+#if defined(KSNI_HAVE_SSE2)
+    done += copySwapSse2(dst + done, src + done, count - done);
+#elif defined(KSNI_HAVE_NEON)
+    done = copySwapNeon(dst, src, count);
+#endif
+    copySwapScalar(dst + done, src + done, count - done);
+#endif
+}
+
+quint64 KStatusNotifierItemImage::contentHash(const QImage &image)
+{
+    // only hash the visible part of each line, the padding is not initialized
+    const qsizetype lineBytes = (qsizetype(image.width()) * image.depth() + 7) / 8;
+    auto hashBits = [&](size_t seed) {
+        if (lineBytes == image.bytesPerLine()) {
+            return qHashBits(image.constBits(), image.sizeInBytes(), seed);
+        }
+        for (int y = 0; y < image.height(); ++y) {
+            seed = qHashBits(image.constScanLine(y), lineBytes, seed);
+        }
+        return seed;
+    };
+
+    const quint64 hash = hashBits(0);
+    if constexpr (sizeof(size_t) < sizeof(quint64)) {
+        // widen the hash on 32 bit platforms, a collision would show a wrong icon
+        return (quint64(hashBits(0x9e3779b9)) << 32) | hash;
+    }
+    return hash;
+}
+
+namespace
+{
+// Converts count pixels starting at src to network byte order ARGB32 into dst
+using PixelConverter = void (*)(quint32 *dst, const uchar *src, qsizetype count);
+
+void convertFromArgb32(quint32 *dst, const uchar *src, qsizetype count)
+{
+    KStatusNotifierItemImage::copyToNetworkByteOrder(dst, reinterpret_cast<const quint32 *>(src), count);
+}
+
+void convertFromRgb32(quint32 *dst, const uchar *src, qsizetype count)
+{
+    const quint32 *pixels = reinterpret_cast<const quint32 *>(src);
+    for (qsizetype i = 0; i < count; ++i) {
+        dst[i] = qToBigEndian(pixels[i] | 0xff000000);
+    }
+}
+
+void convertFromArgb32Premultiplied(quint32 *dst, const uchar *src, qsizetype count)
+{
+    const quint32 *pixels = reinterpret_cast<const quint32 *>(src);
+    for (qsizetype i = 0; i < count; ++i) {
+        dst[i] = qToBigEndian(qUnpremultiply(pixels[i]));
+    }
+}
+
+void convertFromRgba8888(quint32 *dst, const uchar *src, qsizetype count)
+{
+    // R, G, B, A in memory to A, R, G, B in memory, whatever the host byte order
+    uchar *out = reinterpret_cast<uchar *>(dst);
+    for (qsizetype i = 0; i < count; ++i, src += 4, out += 4) {
+        out[0] = src[3];
+        out[1] = src[0];
+        out[2] = src[1];
+        out[3] = src[2];
+    }
+}
+
+void convertFromRgba8888Premultiplied(quint32 *dst, const uchar *src, qsizetype count)
+{
+    for (qsizetype i = 0; i < count; ++i, src += 4) {
+        dst[i] = qToBigEndian(qUnpremultiply(qRgba(src[0], src[1], src[2], src[3])));
+    }
+}
+
+PixelConverter converterForFormat(QImage::Format format)
+{
+    switch (format) {
+    case QImage::Format_ARGB32:
+        return convertFromArgb32;
+    case QImage::Format_RGB32:
+        return convertFromRgb32;
+    case QImage::Format_ARGB32_Premultiplied:
+        return convertFromArgb32Premultiplied;
+    case QImage::Format_RGBA8888:
+    case QImage::Format_RGBX8888:
+        return convertFromRgba8888;
+    case QImage::Format_RGBA8888_Premultiplied:
+        return convertFromRgba8888Premultiplied;
+    default:
+        return nullptr;
+    }
+}
+}
+
+KDbusImageStruct KStatusNotifierItemImage::imageToStruct(const QImage &image)
+{
+    KDbusImageStruct icon;
+    imageToStruct(image, icon);
+    return icon;
+}
+
+void KStatusNotifierItemImage::imageToStruct(const QImage &image, KDbusImageStruct &icon)
+{
+    icon.width = image.size().width();
+    icon.height = image.size().height();
+
+    // the formats QIcon::pixmap() usually hands out are converted in a single pass,
+    // anything else goes through an intermediate ARGB32 copy first
+    PixelConverter convert = converterForFormat(image.format());
+    const QImage source = convert ? image : image.convertToFormat(QImage::Format_ARGB32);
+    if (!convert) {
+        convert = convertFromArgb32;
+    }
+
+    const qsizetype lineLength = source.width();
+    const qsizetype dataSize = lineLength * source.height() * qsizetype(sizeof(quint32));
+    if (icon.data.size() != dataSize || !icon.data.isDetached()) {
+        icon.data = QByteArray(dataSize, Qt::Uninitialized);
+    }
+    quint32 *dst = reinterpret_cast<quint32 *>(icon.data.data());
+
+    if (source.bytesPerLine() == lineLength * qsizetype(sizeof(quint32))) {
+        convert(dst, source.constBits(), lineLength * source.height());
+    } else {
+        for (int y = 0; y < source.height(); ++y) {
+            convert(dst + y * lineLength, source.constScanLine(y), lineLength);
+        }
+    }
+}
+
+QImage KStatusNotifierItemImage::structToImage(const KDbusImageStruct &icon)
+{
+    const qsizetype count = qsizetype(icon.width) * icon.height;
+    if (icon.width <= 0 || icon.height <= 0 || icon.data.size() != count * qsizetype(sizeof(quint32))) {
+        return QImage();
+    }
+
+    // swapping the bytes again restores the host byte order
+    QImage image(icon.width, icon.height, QImage::Format_ARGB32);
+    copyToNetworkByteOrder(reinterpret_cast<quint32 *>(image.bits()), reinterpret_cast<const quint32 *>(icon.data.constData()), count);
+    return image;
+}
+
+// BufferPool
+
+void KStatusNotifierItemImage::BufferPool::recycle(const KDbusImageVector &vector)
+{
+    for (const KDbusImageStruct &icon : vector) {
+        recycle(icon.data);
+    }
+}
+
+void KStatusNotifierItemImage::BufferPool::recycle(const QByteArray &buffer)
+{
+    if (buffer.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_buffers.append(buffer);
+    while (m_buffers.size() > s_maxBuffers) {
+        m_buffers.removeFirst();
+    }
+}
+
+QByteArray KStatusNotifierItemImage::BufferPool::take(qsizetype size)
+{
+    QMutexLocker locker(&m_mutex);
+    for (qsizetype i = 0; i < m_buffers.size(); ++i) {
+        if (m_buffers.at(i).size() == size && m_buffers.at(i).isDetached()) {
+            return m_buffers.takeAt(i);
+        }
+    }
+    ++m_misses;
+    return QByteArray();
+}
+
+quint64 KStatusNotifierItemImage::BufferPool::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+// ImageCache
+
+using namespace KStatusNotifierItemImage;
+
+Q_GLOBAL_STATIC(ImageCache, s_imageCache)
+
+// 8 MiB fit a few dozen large icons, which is plenty for any sane application
+static const qsizetype s_defaultImageCacheCost = 8 * 1024 * 1024;
+
+ImageCache::ImageCache()
+    : m_cache(s_defaultImageCacheCost)
+{
+}
+
+ImageCache *ImageCache::self()
+{
+    return s_imageCache();
+}
+
+ImageCache::Entry::~Entry()
+{
+    // the cache was what kept the buffer from being reused until now
+    if (const std::shared_ptr<BufferPool> buffers = pool.lock()) {
+        buffers->recycle(icon.data);
+    }
+}
+
+KDbusImageStruct ImageCache::imageToStruct(const QImage &image, const std::shared_ptr<BufferPool> &pool)
+{
+    const Key key{image.width(), image.height(), image.format(), contentHash(image)};
+
+    QMutexLocker locker(&m_mutex);
+    if (const Entry *cached = m_cache.object(key)) {
+        return cached->icon;
+    }
+    locker.unlock();
+
+    KDbusImageStruct icon;
+    if (pool) {
+        icon.data = pool->take(qsizetype(image.width()) * image.height() * qsizetype(sizeof(quint32)));
+    }
+    KStatusNotifierItemImage::imageToStruct(image, icon);
+
+    locker.relock();
+    m_cache.insert(key, new Entry{icon, pool}, icon.data.size());
+    return icon;
+}
+
+void ImageCache::setMaxCost(qsizetype bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(bytes);
+}
+
+qsizetype ImageCache::maxCost() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost();
+}
@@ -0,0 +1,157 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KSTATUSNOTIFIERITEMIMAGE_P_H
+#define KSTATUSNOTIFIERITEMIMAGE_P_H
+
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QtGlobal>
+
+#include <memory>
+
+#include "kstatusnotifieritemdbus_p.h"
+
+namespace KStatusNotifierItemImage
+{
+/*
+ * Copies count ARGB32 pixels from src to dst, converting them to network
+ * byte order as the StatusNotifierItem spec requires.
+ *
+ * The conversion is done in a single pass, using SIMD instructions where
+ * available. src and dst must not overlap.
+ */
+void copyToNetworkByteOrder(quint32 *dst, const quint32 *src, qsizetype count);
+
+/*
+ * One of the SIMD kernels copyToNetworkByteOrder() is made of. It converts
+ * as many pixels from the start as its vector width allows, and returns how
+ * many, leaving the tail to the caller.
+ */
+struct ByteOrderKernel {
+    const char *name;
+    qsizetype (*convert)(quint32 *dst, const quint32 *src, qsizetype count);
+};
+
+/*
+ * Returns the kernels usable on this CPU, for testing them one by one
+ */
+QList<ByteOrderKernel> byteOrderKernels();
+
+/*
+ * Returns a hash of the pixel content of image, ignoring the padding at
+ * the end of each line.
+ */
+quint64 contentHash(const QImage &image);
+
+/*
+ * Converts image to the D-Bus wire format, without looking at the cache.
+ */
+KDbusImageStruct imageToStruct(const QImage &image);
+
+/*
+ * Converts image into icon, reusing the allocation of icon.data when it
+ * has the right size and is not shared.
+ */
+void imageToStruct(const QImage &image, KDbusImageStruct &icon);
+
+/*
+ * Converts icon back to an ARGB32 image, for reading back icons which
+ * only exist in serialized form.
+ */
+QImage structToImage(const KDbusImageStruct &icon);
+
+/*
+ * Keeps the pixel buffers of serialized icons that were replaced, so that
+ * converting the next icon of the same size does not need to allocate.
+ *
+ * Buffers shared through the ImageCache are handed back by the cache once
+ * it evicts them, the item recycles the buffers of raw images itself. A
+ * buffer is only handed out again once nothing but the pool references it
+ * anymore, for instance after the snapshot and the D-Bus reply it was sent
+ * with are gone.
+ */
+class BufferPool
+{
+public:
+    void recycle(const KDbusImageVector &vector);
+    void recycle(const QByteArray &buffer);
+    QByteArray take(qsizetype size);
+
+    /*
+     * Returns how many times take() had no buffer to hand out, so that the
+     * caller had to allocate one
+     */
+    quint64 misses() const;
+
+private:
+    static constexpr qsizetype s_maxBuffers = 8;
+
+    mutable QMutex m_mutex;
+    QList<QByteArray> m_buffers;
+    quint64 m_misses = 0;
+};
+
+/*
+ * Process wide cache of serialized images, keyed by their pixel content.
+ *
+ * Identical pixmaps used by several items, or by several roles of the
+ * same item, are serialized once and then share the same implicitly
+ * shared data. Least recently used entries are evicted once the total
+ * size of the cached data goes beyond maxCost() bytes.
+ */
+class ImageCache
+{
+public:
+    ImageCache();
+
+    static ImageCache *self();
+
+    /*
+     * Returns the serialized form of image, converting it only if no
+     * identical image has been serialized before. The buffer for a new
+     * conversion is taken from pool when it has a suitable one, and given
+     * back to it once evicted from the cache.
+     */
+    KDbusImageStruct imageToStruct(const QImage &image, const std::shared_ptr<BufferPool> &pool = {});
+
+    void setMaxCost(qsizetype bytes);
+    qsizetype maxCost() const;
+
+private:
+    struct Key {
+        int width;
+        int height;
+        QImage::Format format;
+        quint64 hash;
+
+        bool operator==(const Key &other) const
+        {
+            return width == other.width && height == other.height && format == other.format && hash == other.hash;
+        }
+
+        friend size_t qHash(const Key &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.width, key.height, int(key.format), key.hash);
+        }
+    };
+
+    struct Entry {
+        ~Entry();
+
+        KDbusImageStruct icon;
+        std::weak_ptr<BufferPool> pool;
+    };
+
+    mutable QMutex m_mutex;
+    QCache<Key, Entry> m_cache;
+};
+}
+
+#endif
@@ -8,23 +8,30 @@
 #ifndef KSTATUSNOTIFIERITEMPRIVATE_H
 #define KSTATUSNOTIFIERITEMPRIVATE_H
 
+#include <QElapsedTimer>
 #include <QEventLoopLocker>
+#include <QFuture>
+#include <QImage>
 #include <QMovie>
 #include <QObject>
 #include <QString>
 #include <QSystemTrayIcon>
 #include <QWheelEvent>
 
+#include <memory>
+#include <optional>
+
 #include "config-kstatusnotifieritem.h"
 #include "kstatusnotifieritem.h"
 
 #if HAVE_DBUS
 #include "kstatusnotifieritemdbus_p.h"
+#include "kstatusnotifieritemimage_p.h"
 
 #include "notifications_interface.h"
-#include "statusnotifierwatcher_interface.h"
 #endif
 
+class KStatusNotifierItemUpdateQueue;
 class KSystemTrayIcon;
 class QMenu;
 class QAction;
@@ -118,18 +125,79 @@ public:
     KStatusNotifierItem *q;
 
 #if HAVE_DBUS
-    KDbusImageStruct imageToStruct(const QImage &image);
-    KDbusImageVector iconToVector(const QIcon &icon);
+    enum IconRole {
+        MainIcon,
+        OverlayIcon,
+        AttentionIcon,
+        ToolTipIcon,
+        IconRoleCount,
+    };
+
+    struct SerializedIconResult {
+        qint64 cacheKey = 0;
+        QList<quint64> fingerprint;
+        KDbusImageVector vector;
+    };
+
+    // Pixmap icons are only marked dirty by the setters, and converted when
+    // the changes are flushed to the host
+    struct SerializedIcon {
+        KDbusImageVector vector;
+        // content hash of every rasterized size of the current pixmap icon
+        QList<quint64> fingerprint;
+        // the QIcon the vector was made from, unset for raw images
+        std::optional<qint64> cacheKey;
+        // asynchronous serialization in flight, see scheduleIconSerialization()
+        QFuture<SerializedIconResult> job;
+        quint64 generation = 0;
+        // bumped whenever vector changes, see KStatusNotifierItemDBus::publishSnapshot()
+        quint64 revision = 0;
+        bool pending = false;
+        bool hasFingerprint = false;
+        bool dirty = false;
+    };
 
-    KDbusImageVector serializedIcon;
-    KDbusImageVector serializedAttentionIcon;
-    KDbusImageVector serializedOverlayIcon;
-    KDbusImageVector serializedToolTipIcon;
+    KDbusImageStruct imageToStruct(const QImage &image);
+    static QList<QImage> iconImages(const QIcon &icon, const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios);
+    static QList<quint64> imagesFingerprint(const QList<QImage> &images);
+    void setHostIconPixmapSizes(const QList<QSize> &sizes, const QList<qreal> &devicePixelRatios);
+    void updateRenderedIconPixmapSizes();
+    void iconPixmapSizesChanged();
+
+    const QIcon &iconForRole(IconRole role) const;
+    const KDbusImageVector &serializedIcon(IconRole role) const;
+    static KStatusNotifierItemDBus::ChangeSignal changeSignalForRole(IconRole role);
+    void clearSerializedIcon(IconRole role);
+    void pixmapIconChanged(IconRole role);
+    KStatusNotifierItemDBus::ChangeSignals serializeChangedIcons();
+    bool serializePixmapIcon(IconRole role);
+    bool setSerializedIcon(IconRole role, const SerializedIconResult &result);
+    void scheduleIconSerialization(IconRole role);
+    void cancelIconSerialization(IconRole role);
+    void iconSerializationFinished(IconRole role, quint64 generation, const SerializedIconResult &result);
+    bool setSerializedImage(IconRole role, const QImage &image);
+
+    SerializedIcon serializedIcons[IconRoleCount];
+    // buffers of replaced icons, shared with the asynchronous serialization jobs
+    std::shared_ptr<KStatusNotifierItemImage::BufferPool> bufferPool = std::make_shared<KStatusNotifierItemImage::BufferPool>();
+    // icon updates dropped because they did not change a single pixel
+    quint64 suppressedIconUpdates = 0;
+
+    void registrationSucceeded();
+    void registrationFailed();
+    void hostRegisteredChanged();
+    // whether a host may read the icons, which are only converted then
+    bool hostsListening() const;
+
+    // invalidates the replies of the registrations started before
+    quint64 registrationAttempt = 0;
+    bool registered = false;
+    QElapsedTimer registrationTimer;
+    qint64 registrationTime = -1;
 
-    org::kde::StatusNotifierWatcher *statusNotifierWatcher = nullptr;
     org::freedesktop::Notifications *notificationsClient = nullptr;
 
-    KStatusNotifierItemDBus *statusNotifierItemDBus;
+    KStatusNotifierItemDBus *statusNotifierItemDBus = nullptr;
 #endif
 
     KStatusNotifierItem::ItemCategory category;
@@ -139,6 +207,8 @@ public:
 
     QString iconName;
     QIcon icon;
+    // set by setIconByImage(), the image is only kept in serialized form
+    bool iconFromImage = false;
 
     QString overlayIconName;
     QIcon overlayIcon;
@@ -148,6 +218,17 @@ public:
     QString movieName;
     QPointer<QMovie> movie;
 
+    // sizes pixmap icons are rasterized at as set by the application, empty
+    // to use the icon's own sizes
+    QList<QSize> iconPixmapSizes;
+    QList<qreal> iconPixmapDevicePixelRatios;
+    // sizes asked for by the hosts through ProvideIconSizes(), empty if none did
+    QList<QSize> hostIconPixmapSizes;
+    QList<qreal> hostIconPixmapDevicePixelRatios;
+    // the sizes of both above, which the icons are actually rasterized at
+    QList<QSize> renderedIconPixmapSizes;
+    QList<qreal> renderedIconPixmapDevicePixelRatios;
+
     QString toolTipIconName;
     QIcon toolTipIcon;
     QString toolTipTitle;
@@ -159,6 +240,8 @@ public:
     QMenu *menu;
     QHash<QString, QAction *> actionCollection;
     QPointer<QWindow> associatedWindow;
+    // read once, winId() creates the native window as a side effect
+    WId associatedWindowId = 0;
     QPoint associatedWindowPos;
     QAction *titleAction;
 
@@ -171,6 +254,15 @@ public:
     bool standardActionsEnabled : 1;
     bool quitAborted = false;
     bool isMenu = false;
+    bool asyncIconSerialization = false;
+    int minimumSignalInterval = 0;
+    // nesting of beginUpdate() calls
+    int updateDepth = 0;
+    bool propertiesChangedSignals = false;
+
+    // shared with the KStatusNotifierItemUpdater handles, created on first use
+    std::shared_ptr<KStatusNotifierItemUpdateQueue> sharedUpdateQueue();
+    std::shared_ptr<KStatusNotifierItemUpdateQueue> updateQueue;
 };
 
 #endif
@@ -0,0 +1,189 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kstatusnotifieritemupdater.h"
+#include "kstatusnotifieritemprivate_p.h"
+#include "kstatusnotifieritemupdater_p.h"
+
+#include <QImage>
+
+#include <optional>
+
+// KStatusNotifierItemUpdateQueue
+
+KStatusNotifierItemUpdateQueue::KStatusNotifierItemUpdateQueue(KStatusNotifierItem *item)
+    : m_item(item)
+{
+}
+
+KStatusNotifierItemUpdateQueue::~KStatusNotifierItemUpdateQueue()
+{
+    deleteNodes(m_head.exchange(nullptr));
+}
+
+void KStatusNotifierItemUpdateQueue::post(Field field, const QVariant &value)
+{
+    if (m_detached.load()) {
+        return;
+    }
+
+    // sequentially consistent, as are the operations of drain(): the push and
+    // the flag are two locations, with weaker orders drain() could clear the
+    // flag without seeing the node while this still sees the flag set
+    Node *node = new Node{field, value, m_head.load(std::memory_order_relaxed)};
+    while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_seq_cst, std::memory_order_relaxed)) { }
+
+    // the first update after a drain wakes up the GUI thread, the later ones ride along
+    if (m_drainScheduled.exchange(true)) {
+        return;
+    }
+
+    QMutexLocker locker(&m_itemMutex);
+    if (m_item) {
+        QMetaObject::invokeMethod(
+            m_item,
+            [self = shared_from_this()]() {
+                self->drain();
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void KStatusNotifierItemUpdateQueue::detach()
+{
+    m_detached.store(true);
+    {
+        QMutexLocker locker(&m_itemMutex);
+        m_item = nullptr;
+    }
+
+    // an update racing with this one may still be pushed, the destructor frees it
+    deleteNodes(m_head.exchange(nullptr));
+}
+
+void KStatusNotifierItemUpdateQueue::drain()
+{
+    // allow the next update to schedule another drain before taking the
+    // current ones, so none of them can be left behind, see post()
+    m_drainScheduled.store(false);
+    Node *node = m_head.exchange(nullptr);
+
+    // the stack holds the newest update first, so the first value seen for a
+    // field is the one to apply
+    std::optional<QVariant> latest[FieldCount];
+    for (Node *it = node; it; it = it->next) {
+        if (!latest[it->field]) {
+            latest[it->field] = it->value;
+        }
+    }
+    deleteNodes(node);
+
+    KStatusNotifierItem *item = m_item;
+    if (!item) {
+        return;
+    }
+
+    item->beginUpdate();
+    if (latest[Title]) {
+        item->setTitle(latest[Title]->toString());
+    }
+    if (latest[Icon]) {
+        if (latest[Icon]->metaType() == QMetaType::fromType<QImage>()) {
+            item->setIconByImage(latest[Icon]->value<QImage>());
+        } else {
+            item->setIconByName(latest[Icon]->toString());
+        }
+    }
+    if (latest[OverlayIconName]) {
+        item->setOverlayIconByName(latest[OverlayIconName]->toString());
+    }
+    if (latest[AttentionIconName]) {
+        item->setAttentionIconByName(latest[AttentionIconName]->toString());
+    }
+    if (latest[ToolTipIconName]) {
+        item->setToolTipIconByName(latest[ToolTipIconName]->toString());
+    }
+    if (latest[ToolTipTitle]) {
+        item->setToolTipTitle(latest[ToolTipTitle]->toString());
+    }
+    if (latest[ToolTipSubTitle]) {
+        item->setToolTipSubTitle(latest[ToolTipSubTitle]->toString());
+    }
+    if (latest[Status]) {
+        item->setStatus(static_cast<KStatusNotifierItem::ItemStatus>(latest[Status]->toInt()));
+    }
+    item->commitUpdate();
+}
+
+void KStatusNotifierItemUpdateQueue::deleteNodes(Node *node)
+{
+    while (node) {
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+// KStatusNotifierItemUpdater
+
+KStatusNotifierItemUpdater::KStatusNotifierItemUpdater(KStatusNotifierItem *item)
+    : d(item->d->sharedUpdateQueue())
+{
+}
+
+KStatusNotifierItemUpdater::KStatusNotifierItemUpdater(const KStatusNotifierItemUpdater &other) = default;
+
+KStatusNotifierItemUpdater &KStatusNotifierItemUpdater::operator=(const KStatusNotifierItemUpdater &other) = default;
+
+KStatusNotifierItemUpdater::~KStatusNotifierItemUpdater() = default;
+
+void KStatusNotifierItemUpdater::setStatus(KStatusNotifierItem::ItemStatus status)
+{
+    d->post(KStatusNotifierItemUpdateQueue::Status, int(status));
+}
+
+void KStatusNotifierItemUpdater::setTitle(const QString &title)
+{
+    d->post(KStatusNotifierItemUpdateQueue::Title, title);
+}
+
+void KStatusNotifierItemUpdater::setIconByName(const QString &name)
+{
+    d->post(KStatusNotifierItemUpdateQueue::Icon, name);
+}
+
+void KStatusNotifierItemUpdater::setIconByImage(const QImage &image)
+{
+    // the image may wrap a buffer the calling thread paints the next frame
+    // into, or frees, before the GUI thread gets to it
+    d->post(KStatusNotifierItemUpdateQueue::Icon, image.copy());
+}
+
+void KStatusNotifierItemUpdater::setOverlayIconByName(const QString &name)
+{
+    d->post(KStatusNotifierItemUpdateQueue::OverlayIconName, name);
+}
+
+void KStatusNotifierItemUpdater::setAttentionIconByName(const QString &name)
+{
+    d->post(KStatusNotifierItemUpdateQueue::AttentionIconName, name);
+}
+
+void KStatusNotifierItemUpdater::setToolTipIconByName(const QString &name)
+{
+    d->post(KStatusNotifierItemUpdateQueue::ToolTipIconName, name);
+}
+
+void KStatusNotifierItemUpdater::setToolTipTitle(const QString &title)
+{
+    d->post(KStatusNotifierItemUpdateQueue::ToolTipTitle, title);
+}
+
+void KStatusNotifierItemUpdater::setToolTipSubTitle(const QString &subTitle)
+{
+    d->post(KStatusNotifierItemUpdateQueue::ToolTipSubTitle, subTitle);
+}
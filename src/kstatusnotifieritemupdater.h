@@ -0,0 +1,111 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KSTATUSNOTIFIERITEMUPDATER_H
+#define KSTATUSNOTIFIERITEMUPDATER_H
+
+#include <kstatusnotifieritem.h>
+#include <kstatusnotifieritem_export.h>
+
+#include <memory>
+
+class QImage;
+class KStatusNotifierItemUpdateQueue;
+
+/*!
+ * \class KStatusNotifierItemUpdater
+ * \inmodule KStatusNotifierItem
+ *
+ * \brief Updates a KStatusNotifierItem from any thread.
+ *
+ * The setters of KStatusNotifierItem must be called from the GUI thread.
+ * An updater can be copied to worker threads instead, and its setters called
+ * from any of them, concurrently. Posting an update never blocks.
+ *
+ * The updates are applied to the item by the GUI thread on its next event
+ * loop iteration. Updates to the same property made in between are collapsed,
+ * only the latest value gets applied. Updates posted after the item has been
+ * destroyed are dropped.
+ *
+ * \code
+ * KStatusNotifierItemUpdater updater(item);
+ * QThreadPool::globalInstance()->start([updater]() mutable {
+ *     updater.setToolTipSubTitle(computeProgress());
+ *     updater.setStatus(KStatusNotifierItem::Active);
+ * });
+ * \endcode
+ *
+ * \since 6.29
+ */
+class KSTATUSNOTIFIERITEM_EXPORT KStatusNotifierItemUpdater
+{
+public:
+    /*!
+     * \brief Creates an updater for \a item.
+     *
+     * Must be called from the GUI thread, the resulting updater can then be
+     * copied to and used from any thread.
+     */
+    explicit KStatusNotifierItemUpdater(KStatusNotifierItem *item);
+
+    KStatusNotifierItemUpdater(const KStatusNotifierItemUpdater &other);
+    KStatusNotifierItemUpdater &operator=(const KStatusNotifierItemUpdater &other);
+    ~KStatusNotifierItemUpdater();
+
+    /*!
+     * \sa KStatusNotifierItem::setStatus()
+     */
+    void setStatus(KStatusNotifierItem::ItemStatus status);
+
+    /*!
+     * \sa KStatusNotifierItem::setTitle()
+     */
+    void setTitle(const QString &title);
+
+    /*!
+     * \sa KStatusNotifierItem::setIconByName()
+     */
+    void setIconByName(const QString &name);
+
+    /*!
+     * The pixels of \a image are copied, as the item only picks them up
+     * later in the GUI thread. The buffer may be reused right after the call.
+     *
+     * \sa KStatusNotifierItem::setIconByImage()
+     */
+    void setIconByImage(const QImage &image);
+
+    /*!
+     * \sa KStatusNotifierItem::setOverlayIconByName()
+     */
+    void setOverlayIconByName(const QString &name);
+
+    /*!
+     * \sa KStatusNotifierItem::setAttentionIconByName()
+     */
+    void setAttentionIconByName(const QString &name);
+
+    /*!
+     * \sa KStatusNotifierItem::setToolTipIconByName()
+     */
+    void setToolTipIconByName(const QString &name);
+
+    /*!
+     * \sa KStatusNotifierItem::setToolTipTitle()
+     */
+    void setToolTipTitle(const QString &title);
+
+    /*!
+     * \sa KStatusNotifierItem::setToolTipSubTitle()
+     */
+    void setToolTipSubTitle(const QString &subTitle);
+
+private:
+    std::shared_ptr<KStatusNotifierItemUpdateQueue> d;
+};
+
+#endif
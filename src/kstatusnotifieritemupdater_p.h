@@ -0,0 +1,71 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KSTATUSNOTIFIERITEMUPDATER_P_H
+#define KSTATUSNOTIFIERITEMUPDATER_P_H
+
+#include <QMutex>
+#include <QVariant>
+
+#include <atomic>
+#include <memory>
+
+class KStatusNotifierItem;
+
+/*
+ * The updates posted through KStatusNotifierItemUpdater, waiting to be
+ * applied to the item by the GUI thread.
+ *
+ * Producers push onto a lock-free stack, the GUI thread takes the whole
+ * stack at once and applies the newest value of each field. Only waking up the GUI
+ * thread, once per batch of updates, takes a lock, guarding against the
+ * item going away at the same time.
+ */
+class KStatusNotifierItemUpdateQueue : public std::enable_shared_from_this<KStatusNotifierItemUpdateQueue>
+{
+public:
+    enum Field {
+        Status,
+        Title,
+        Icon,
+        OverlayIconName,
+        AttentionIconName,
+        ToolTipIconName,
+        ToolTipTitle,
+        ToolTipSubTitle,
+        FieldCount,
+    };
+
+    explicit KStatusNotifierItemUpdateQueue(KStatusNotifierItem *item);
+    ~KStatusNotifierItemUpdateQueue();
+
+    // any thread
+    void post(Field field, const QVariant &value);
+
+    // GUI thread, before the item is destroyed
+    void detach();
+
+private:
+    struct Node {
+        Field field;
+        QVariant value;
+        Node *next;
+    };
+
+    void drain();
+    static void deleteNodes(Node *node);
+
+    std::atomic<Node *> m_head = nullptr;
+    std::atomic<bool> m_drainScheduled = false;
+    // the item is gone, updates are dropped instead of queued
+    std::atomic<bool> m_detached = false;
+
+    QMutex m_itemMutex;
+    KStatusNotifierItem *m_item;
+};
+
+#endif
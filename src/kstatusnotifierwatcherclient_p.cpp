@@ -0,0 +1,254 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kstatusnotifierwatcherclient_p.h"
+#include "debug_p.h"
+#include "kstatusnotifieritemdbus_p.h"
+#include "kstatusnotifieritemprivate_p.h"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QPointer>
+
+#include <utility>
+
+static const char s_statusNotifierWatcherServiceName[] = "org.kde.StatusNotifierWatcher";
+static const char s_statusNotifierWatcherPath[] = "/StatusNotifierWatcher";
+static const char s_statusNotifierWatcherInterface[] = "org.kde.StatusNotifierWatcher";
+
+static QPointer<KStatusNotifierWatcherClient> s_self;
+
+KStatusNotifierWatcherClient::KStatusNotifierWatcherClient(QObject *parent)
+    : QObject(parent)
+    , m_serviceWatcher(QString::fromLatin1(s_statusNotifierWatcherServiceName), QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForOwnerChange)
+{
+    connect(&m_serviceWatcher, &QDBusServiceWatcher::serviceOwnerChanged, this, &KStatusNotifierWatcherClient::serviceOwnerChanged);
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    bus.connect(QString::fromLatin1(s_statusNotifierWatcherServiceName),
+                QString::fromLatin1(s_statusNotifierWatcherPath),
+                QString::fromLatin1(s_statusNotifierWatcherInterface),
+                QStringLiteral("StatusNotifierHostRegistered"),
+                this,
+                SLOT(hostRegistered()));
+    bus.connect(QString::fromLatin1(s_statusNotifierWatcherServiceName),
+                QString::fromLatin1(s_statusNotifierWatcherPath),
+                QString::fromLatin1(s_statusNotifierWatcherInterface),
+                QStringLiteral("StatusNotifierHostUnregistered"),
+                this,
+                SLOT(hostUnregistered()));
+}
+
+KStatusNotifierWatcherClient *KStatusNotifierWatcherClient::self()
+{
+    if (!s_self) {
+        s_self = new KStatusNotifierWatcherClient(QCoreApplication::instance());
+    }
+    return s_self;
+}
+
+void KStatusNotifierWatcherClient::registerItem(KStatusNotifierItemPrivate *item)
+{
+    if (!m_items.contains(item)) {
+        m_items.append(item);
+    }
+
+    switch (m_state) {
+    case Available:
+        sendRegistration(item);
+        break;
+    case Unavailable:
+        item->registrationFailed();
+        break;
+    case Unknown:
+        queryProtocolVersion();
+        Q_FALLTHROUGH();
+    case Querying:
+        if (!m_waitingItems.contains(item)) {
+            m_waitingItems.append(item);
+        }
+        // sent without waiting for the version, but the outcome is only
+        // acted upon once the version is known, see registrationReplied()
+        m_earlyReplies.remove(item);
+        sendRegistration(item);
+        break;
+    }
+}
+
+void KStatusNotifierWatcherClient::removeItem(KStatusNotifierItemPrivate *item)
+{
+    if (s_self) {
+        s_self->m_items.removeOne(item);
+        s_self->m_waitingItems.removeOne(item);
+        s_self->m_earlyReplies.remove(item);
+    }
+}
+
+bool KStatusNotifierWatcherClient::isHostRegistered() const
+{
+    return m_hostRegistered;
+}
+
+void KStatusNotifierWatcherClient::queryProtocolVersion()
+{
+    qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Reading the protocol version of the KStatusNotifierWatcher";
+    m_state = Querying;
+    const quint64 generation = ++m_generation;
+
+    // the host registration comes along in the same round trip
+    QDBusMessage msg = QDBusMessage::createMethodCall(QString::fromLatin1(s_statusNotifierWatcherServiceName),
+                                                      QString::fromLatin1(s_statusNotifierWatcherPath),
+                                                      QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                      QStringLiteral("GetAll"));
+    msg.setArguments(QVariantList{QString::fromLatin1(s_statusNotifierWatcherInterface)});
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, generation] {
+        watcher->deleteLater();
+        if (generation != m_generation) {
+            return;
+        }
+
+        QDBusPendingReply<QVariantMap> reply = *watcher;
+        bool ok = false;
+        if (reply.isError()) {
+            qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Failed to read protocol version of KStatusNotifierWatcher";
+        } else {
+            const QVariantMap properties = reply.value();
+            const int protocolVersion = properties.value(QStringLiteral("ProtocolVersion")).toInt(&ok);
+            if (!ok || protocolVersion != KStatusNotifierItemPrivate::s_protocolVersion) {
+                qCDebug(LOG_KSTATUSNOTIFIERITEM) << "KStatusNotifierWatcher has incorrect protocol version";
+                ok = false;
+            }
+            // before the items are told, so they see the host once registered
+            m_hostRegistered = properties.value(QStringLiteral("IsStatusNotifierHostRegistered")).toBool();
+        }
+        m_state = ok ? Available : Unavailable;
+
+        // the items may be destroyed while being told, work on a copy
+        const QList<KStatusNotifierItemPrivate *> waitingItems = std::exchange(m_waitingItems, {});
+        const QHash<KStatusNotifierItemPrivate *, bool> earlyReplies = std::exchange(m_earlyReplies, {});
+        for (KStatusNotifierItemPrivate *item : waitingItems) {
+            if (!m_items.contains(item)) {
+                continue;
+            }
+            if (!ok) {
+                // also drops the reply to the registration sent along, so an
+                // incompatible watcher accepting the item does not make it
+                // show up next to the legacy tray icon
+                item->registrationFailed();
+            } else if (earlyReplies.contains(item)) {
+                registrationReplied(item, earlyReplies.value(item));
+            }
+            // otherwise the reply is still on its way, see registrationReplied()
+        }
+    });
+}
+
+void KStatusNotifierWatcherClient::sendRegistration(KStatusNotifierItemPrivate *item)
+{
+    const quint64 attempt = item->registrationAttempt;
+    item->statusNotifierItemDBus->whenConnected([item, attempt]() {
+        if (attempt != item->registrationAttempt) {
+            return;
+        }
+        QDBusMessage msg = QDBusMessage::createMethodCall(QString::fromLatin1(s_statusNotifierWatcherServiceName),
+                                                          QString::fromLatin1(s_statusNotifierWatcherPath),
+                                                          QString::fromLatin1(s_statusNotifierWatcherInterface),
+                                                          QStringLiteral("RegisterStatusNotifierItem"));
+        msg.setArguments(QVariantList{item->statusNotifierItemDBus->registrationName()});
+        // the replies are delivered in the context of the item, so they get dropped with it
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), item->q);
+        connect(watcher, &QDBusPendingCallWatcher::finished, item->q, [item, watcher, attempt] {
+            watcher->deleteLater();
+            if (attempt != item->registrationAttempt || !s_self) {
+                return;
+            }
+            if (watcher->isError()) {
+                qCDebug(LOG_KSTATUSNOTIFIERITEM) << "Failed to register to the KStatusNotifierWatcher:" << watcher->error().message();
+            }
+            s_self->registrationReplied(item, !watcher->isError());
+        });
+    });
+}
+
+void KStatusNotifierWatcherClient::registrationReplied(KStatusNotifierItemPrivate *item, bool accepted)
+{
+    if (m_waitingItems.contains(item)) {
+        // the watcher may still turn out to be incompatible
+        m_earlyReplies.insert(item, accepted);
+        return;
+    }
+
+    if (accepted) {
+        item->registrationSucceeded();
+    } else {
+        item->registrationFailed();
+    }
+}
+
+void KStatusNotifierWatcherClient::serviceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner)
+{
+    // a new watcher needs to be asked for its version again, which the first
+    // item registering again triggers
+    ++m_generation;
+    m_state = newOwner.isEmpty() ? Unavailable : Unknown;
+    m_waitingItems.clear();
+    m_earlyReplies.clear();
+    // a new watcher starts without hosts, and tells once one shows up
+    m_hostRegistered = false;
+
+    const QList<KStatusNotifierItemPrivate *> items = m_items;
+    for (KStatusNotifierItemPrivate *item : items) {
+        if (m_items.contains(item)) {
+            item->serviceChange(name, oldOwner, newOwner);
+        }
+    }
+}
+
+void KStatusNotifierWatcherClient::hostRegistered()
+{
+    setHostRegistered(true);
+}
+
+void KStatusNotifierWatcherClient::hostUnregistered()
+{
+    // other hosts may still be there
+    QDBusMessage msg = QDBusMessage::createMethodCall(QString::fromLatin1(s_statusNotifierWatcherServiceName),
+                                                      QString::fromLatin1(s_statusNotifierWatcherPath),
+                                                      QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                      QStringLiteral("Get"));
+    msg.setArguments(QVariantList{QString::fromLatin1(s_statusNotifierWatcherInterface), QStringLiteral("IsStatusNotifierHostRegistered")});
+    const quint64 generation = m_generation;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, generation] {
+        watcher->deleteLater();
+        if (generation != m_generation) {
+            return;
+        }
+        QDBusPendingReply<QVariant> reply = *watcher;
+        setHostRegistered(!reply.isError() && reply.value().toBool());
+    });
+}
+
+void KStatusNotifierWatcherClient::setHostRegistered(bool registered)
+{
+    if (std::exchange(m_hostRegistered, registered) == registered) {
+        return;
+    }
+
+    const QList<KStatusNotifierItemPrivate *> items = m_items;
+    for (KStatusNotifierItemPrivate *item : items) {
+        if (m_items.contains(item)) {
+            item->hostRegisteredChanged();
+        }
+    }
+}
+
+#include "moc_kstatusnotifierwatcherclient_p.cpp"
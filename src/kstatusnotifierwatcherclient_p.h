@@ -0,0 +1,85 @@
+/*
+    This file is part of the KDE libraries
+    SPDX-FileCopyrightText: 2026 The KDE Community
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KSTATUSNOTIFIERWATCHERCLIENT_P_H
+#define KSTATUSNOTIFIERWATCHERCLIENT_P_H
+
+#include <QDBusServiceWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+
+class KStatusNotifierItemPrivate;
+
+/*
+ * Talks to the StatusNotifierWatcher on behalf of all the items of the
+ * application.
+ *
+ * A single service watcher follows the watcher on the bus, and its protocol
+ * version is read once for all items. Each item still sends its own
+ * registration right away, without waiting for the version, so registering
+ * takes a single round trip. The outcome of a registration is only handed
+ * out to the item once the version turned out to be compatible.
+ *
+ * Whether a host is registered is read along with the version, and then
+ * followed through the signals of the watcher.
+ */
+class KStatusNotifierWatcherClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    static KStatusNotifierWatcherClient *self();
+
+    /*
+     * Registers item with the watcher, calling registrationSucceeded() or
+     * registrationFailed() on it once the outcome is known
+     */
+    void registerItem(KStatusNotifierItemPrivate *item);
+
+    /*
+     * Forgets about item, which is about to be destroyed
+     */
+    static void removeItem(KStatusNotifierItemPrivate *item);
+
+    /*
+     * Whether a host showing the items is registered with the watcher
+     */
+    bool isHostRegistered() const;
+
+private Q_SLOTS:
+    void hostRegistered();
+    void hostUnregistered();
+
+private:
+    explicit KStatusNotifierWatcherClient(QObject *parent);
+
+    void queryProtocolVersion();
+    void sendRegistration(KStatusNotifierItemPrivate *item);
+    void registrationReplied(KStatusNotifierItemPrivate *item, bool accepted);
+    void serviceOwnerChanged(const QString &name, const QString &oldOwner, const QString &newOwner);
+    void setHostRegistered(bool registered);
+
+    enum State {
+        Unknown,
+        Querying,
+        Available,
+        Unavailable,
+    };
+
+    QDBusServiceWatcher m_serviceWatcher;
+    State m_state = Unknown;
+    // invalidates the replies to protocol version queries sent before
+    quint64 m_generation = 0;
+    bool m_hostRegistered = false;
+    QList<KStatusNotifierItemPrivate *> m_items;
+    QList<KStatusNotifierItemPrivate *> m_waitingItems;
+    // replies to registrations which arrived before the protocol version
+    QHash<KStatusNotifierItemPrivate *, bool> m_earlyReplies;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/* This file is part of the dbusmenu-qt library
+   SPDX-FileCopyrightText: 2026 The KDE Community
+
+   SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#include "dbusmenuactionproperties_p.h"
+
+static const struct {
+    DBusMenuActionProperties::Property property;
+    const char *name;
+} s_propertyNames[] = {
+    {DBusMenuActionProperties::Type, "type"},
+    {DBusMenuActionProperties::Label, "label"},
+    {DBusMenuActionProperties::Enabled, "enabled"},
+    {DBusMenuActionProperties::Visible, "visible"},
+    {DBusMenuActionProperties::ChildrenDisplay, "children-display"},
+    {DBusMenuActionProperties::ToggleType, "toggle-type"},
+    {DBusMenuActionProperties::ToggleState, "toggle-state"},
+    {DBusMenuActionProperties::IconName, "icon-name"},
+    {DBusMenuActionProperties::Shortcut, "shortcut"},
+    {DBusMenuActionProperties::KdeTitle, "x-kde-title"},
+};
+
+void DBusMenuActionProperties::setSeparator()
+{
+    m_separator = true;
+    m_present |= Type;
+}
+
+void DBusMenuActionProperties::setKdeTitle()
+{
+    m_kdeTitle = true;
+    m_present |= KdeTitle;
+}
+
+void DBusMenuActionProperties::setLabel(const QString &label)
+{
+    m_label = label;
+    m_present |= Label;
+}
+
+void DBusMenuActionProperties::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_present.setFlag(Enabled, !enabled);
+}
+
+void DBusMenuActionProperties::setVisible(bool visible)
+{
+    m_visible = visible;
+    m_present.setFlag(Visible, !visible);
+}
+
+void DBusMenuActionProperties::setSubmenu()
+{
+    m_submenu = true;
+    m_present |= ChildrenDisplay;
+}
+
+void DBusMenuActionProperties::setToggle(Toggle toggle, bool checked)
+{
+    m_toggle = toggle;
+    m_checked = checked;
+    m_present.setFlag(ToggleType, toggle != NoToggle);
+    m_present.setFlag(ToggleState, toggle != NoToggle);
+}
+
+void DBusMenuActionProperties::setIconName(const QString &iconName)
+{
+    m_iconName = iconName;
+    m_present.setFlag(IconName, !iconName.isEmpty());
+}
+
+void DBusMenuActionProperties::setShortcut(const DBusMenuShortcut &shortcut)
+{
+    m_shortcut = shortcut;
+    m_present.setFlag(Shortcut, !shortcut.isEmpty());
+}
+
+DBusMenuActionProperties::Properties DBusMenuActionProperties::changedProperties(const DBusMenuActionProperties &other) const
+{
+    Properties changed = m_present ^ other.m_present;
+    const Properties both = m_present & other.m_present;
+
+    if (both & Type && m_separator != other.m_separator) {
+        changed |= Type;
+    }
+    if (both & Label && m_label != other.m_label) {
+        changed |= Label;
+    }
+    if (both & Enabled && m_enabled != other.m_enabled) {
+        changed |= Enabled;
+    }
+    if (both & Visible && m_visible != other.m_visible) {
+        changed |= Visible;
+    }
+    if (both & ChildrenDisplay && m_submenu != other.m_submenu) {
+        changed |= ChildrenDisplay;
+    }
+    if (both & ToggleType && m_toggle != other.m_toggle) {
+        changed |= ToggleType;
+    }
+    if (both & ToggleState && m_checked != other.m_checked) {
+        changed |= ToggleState;
+    }
+    if (both & IconName && m_iconName != other.m_iconName) {
+        changed |= IconName;
+    }
+    if (both & Shortcut && m_shortcut != other.m_shortcut) {
+        changed |= Shortcut;
+    }
+    if (both & KdeTitle && m_kdeTitle != other.m_kdeTitle) {
+        changed |= KdeTitle;
+    }
+    return changed;
+}
+
+QVariant DBusMenuActionProperties::value(Property property) const
+{
+    switch (property) {
+    case Type:
+        return QStringLiteral("separator");
+    case Label:
+        return m_label;
+    case Enabled:
+        return m_enabled;
+    case Visible:
+        return m_visible;
+    case ChildrenDisplay:
+        return QStringLiteral("submenu");
+    case ToggleType:
+        return m_toggle == Radio ? QStringLiteral("radio") : QStringLiteral("checkmark");
+    case ToggleState:
+        return m_checked ? 1 : 0;
+    case IconName:
+        return m_iconName;
+    case Shortcut:
+        return QVariant::fromValue(m_shortcut);
+    case KdeTitle:
+        return m_kdeTitle;
+    }
+    return QVariant();
+}
+
+QVariantMap DBusMenuActionProperties::toMap(Properties properties) const
+{
+    QVariantMap map;
+    properties &= m_present;
+    for (const auto &entry : s_propertyNames) {
+        if (properties & entry.property) {
+            map.insert(QString::fromLatin1(entry.name), value(entry.property));
+        }
+    }
+    return map;
+}
+
+DBusMenuActionProperties::Properties DBusMenuActionProperties::fromNames(const QStringList &names)
+{
+    Properties properties;
+    for (const QString &name : names) {
+        for (const auto &entry : s_propertyNames) {
+            if (name == QLatin1String(entry.name)) {
+                properties |= entry.property;
+                break;
+            }
+        }
+    }
+    return properties;
+}
+
+QStringList DBusMenuActionProperties::names(Properties properties)
+{
+    QStringList list;
+    for (const auto &entry : s_propertyNames) {
+        if (properties & entry.property) {
+            list << QString::fromLatin1(entry.name);
+        }
+    }
+    return list;
+}
@@ -0,0 +1,97 @@
+/* This file is part of the dbusmenu-qt library
+   SPDX-FileCopyrightText: 2026 The KDE Community
+
+   SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef DBUSMENUACTIONPROPERTIES_P_H
+#define DBUSMENUACTIONPROPERTIES_P_H
+
+// Local
+#include "dbusmenushortcut_p.h"
+
+// Qt
+#include <QFlags>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+/**
+ * The DBusMenu properties of an exported action, as typed fields.
+ *
+ * Only the properties set in present() exist on the bus, the others have
+ * their default value in the spec and are left out. QVariant maps are built
+ * from the fields when the properties are sent.
+ */
+class DBusMenuActionProperties
+{
+public:
+    enum Property {
+        Type = 1 << 0,
+        Label = 1 << 1,
+        Enabled = 1 << 2,
+        Visible = 1 << 3,
+        ChildrenDisplay = 1 << 4,
+        ToggleType = 1 << 5,
+        ToggleState = 1 << 6,
+        IconName = 1 << 7,
+        Shortcut = 1 << 8,
+        KdeTitle = 1 << 9,
+    };
+    Q_DECLARE_FLAGS(Properties, Property)
+
+    enum Toggle : quint8 {
+        NoToggle,
+        Checkmark,
+        Radio,
+    };
+
+    void setSeparator();
+    void setKdeTitle();
+    void setLabel(const QString &label);
+    void setEnabled(bool enabled);
+    void setVisible(bool visible);
+    void setSubmenu();
+    void setToggle(Toggle toggle, bool checked);
+    void setIconName(const QString &iconName);
+    void setShortcut(const DBusMenuShortcut &shortcut);
+
+    Properties present() const
+    {
+        return m_present;
+    }
+
+    /**
+     * The properties which appeared, disappeared or changed value in other
+     */
+    Properties changedProperties(const DBusMenuActionProperties &other) const;
+
+    QVariant value(Property property) const;
+    QVariantMap toMap(Properties properties) const;
+    QVariantMap toMap() const
+    {
+        return toMap(m_present);
+    }
+
+    /**
+     * Names which are not in the record, such as "icon-data", are ignored
+     */
+    static Properties fromNames(const QStringList &names);
+    static QStringList names(Properties properties);
+
+private:
+    QString m_label;
+    QString m_iconName;
+    DBusMenuShortcut m_shortcut;
+    Properties m_present;
+    Toggle m_toggle = NoToggle;
+    bool m_separator = false;
+    bool m_kdeTitle = false;
+    bool m_enabled = true;
+    bool m_visible = true;
+    bool m_submenu = false;
+    bool m_checked = false;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(DBusMenuActionProperties::Properties)
+
+#endif /* DBUSMENUACTIONPROPERTIES_P_H */
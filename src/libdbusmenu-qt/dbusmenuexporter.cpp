@@ -9,7 +9,9 @@
 // Qt
 #include <QActionGroup>
 #include <QBuffer>
+#include <QDBusArgument>
 #include <QDateTime>
+#include <QIcon>
 #include <QMap>
 #include <QMenu>
 #include <QSet>
@@ -19,6 +21,7 @@
 
 // Local
 #include "dbusmenu_p.h"
+#include "dbusmenuactionproperties_p.h"
 #include "dbusmenuexporterdbus_p.h"
 #include "dbusmenuexporterprivate_p.h"
 #include "dbusmenushortcut_p.h"
@@ -28,6 +31,11 @@
 
 static const char *KMENU_TITLE = "kmenu_title";
 
+static const int ICON_DATA_SIZE = 16;
+
+// Total size of the cached PNG data, in bytes
+static const int ICON_DATA_CACHE_COST = 1024 * 1024;
+
 //-------------------------------------------------
 //
 // DBusMenuExporterPrivate
@@ -39,6 +47,18 @@ int DBusMenuExporterPrivate::idForAction(QAction *action) const
     return m_idForAction.value(action, -2);
 }
 
+QAction *DBusMenuExporterPrivate::actionForId(int id) const
+{
+    if (id <= 0) {
+        return nullptr;
+    }
+    if (id < m_firstDenseId) {
+        return m_sparseActionForId.value(id);
+    }
+    const qsizetype index = id - m_firstDenseId;
+    return index < m_actionForId.size() ? m_actionForId.at(index) : nullptr;
+}
+
 void DBusMenuExporterPrivate::addMenu(QMenu *menu, int parentId)
 {
     if (menu->findChild<DBusMenu *>()) {
@@ -53,9 +73,9 @@ void DBusMenuExporterPrivate::addMenu(QMenu *menu, int parentId)
     }
 }
 
-QVariantMap DBusMenuExporterPrivate::propertiesForAction(QAction *action) const
+DBusMenuActionProperties DBusMenuExporterPrivate::propertiesForAction(QAction *action) const
 {
-    DMRETURN_VALUE_IF_FAIL(action, QVariantMap());
+    DMRETURN_VALUE_IF_FAIL(action, DBusMenuActionProperties());
 
     if (action->objectName() == QString::fromLatin1(KMENU_TITLE)) {
         // Hack: Support for KDE menu titles in a Qt-only library...
@@ -67,63 +87,53 @@ QVariantMap DBusMenuExporterPrivate::propertiesForAction(QAction *action) const
     }
 }
 
-QVariantMap DBusMenuExporterPrivate::propertiesForKMenuTitleAction(QAction *action_) const
+DBusMenuActionProperties DBusMenuExporterPrivate::propertiesForKMenuTitleAction(QAction *action_) const
 {
-    QVariantMap map;
+    DBusMenuActionProperties properties;
     // In case the other side does not know about x-kde-title, show a disabled item
-    map.insert(QStringLiteral("enabled"), false);
-    map.insert(QStringLiteral("x-kde-title"), true);
+    properties.setEnabled(false);
+    properties.setKdeTitle();
 
     const QWidgetAction *widgetAction = qobject_cast<const QWidgetAction *>(action_);
-    DMRETURN_VALUE_IF_FAIL(widgetAction, map);
+    DMRETURN_VALUE_IF_FAIL(widgetAction, properties);
     QToolButton *button = qobject_cast<QToolButton *>(widgetAction->defaultWidget());
-    DMRETURN_VALUE_IF_FAIL(button, map);
+    DMRETURN_VALUE_IF_FAIL(button, properties);
     QAction *action = button->defaultAction();
-    DMRETURN_VALUE_IF_FAIL(action, map);
+    DMRETURN_VALUE_IF_FAIL(action, properties);
 
-    map.insert(QStringLiteral("label"), swapMnemonicChar(action->text(), QLatin1Char('&'), QLatin1Char('_')));
-    insertIconProperty(&map, action);
-    if (!action->isVisible()) {
-        map.insert(QStringLiteral("visible"), false);
-    }
-    return map;
+    properties.setLabel(swapMnemonicChar(action->text(), QLatin1Char('&'), QLatin1Char('_')));
+    insertIconProperty(&properties, action);
+    properties.setVisible(action->isVisible());
+    return properties;
 }
 
-QVariantMap DBusMenuExporterPrivate::propertiesForSeparatorAction(QAction *action) const
+DBusMenuActionProperties DBusMenuExporterPrivate::propertiesForSeparatorAction(QAction *action) const
 {
-    QVariantMap map;
-    map.insert(QStringLiteral("type"), QStringLiteral("separator"));
-    if (!action->isVisible()) {
-        map.insert(QStringLiteral("visible"), false);
-    }
-    return map;
+    DBusMenuActionProperties properties;
+    properties.setSeparator();
+    properties.setVisible(action->isVisible());
+    return properties;
 }
 
-QVariantMap DBusMenuExporterPrivate::propertiesForStandardAction(QAction *action) const
+DBusMenuActionProperties DBusMenuExporterPrivate::propertiesForStandardAction(QAction *action) const
 {
-    QVariantMap map;
-    map.insert(QStringLiteral("label"), swapMnemonicChar(action->text(), QLatin1Char('&'), QLatin1Char('_')));
-    if (!action->isEnabled()) {
-        map.insert(QStringLiteral("enabled"), false);
-    }
-    if (!action->isVisible()) {
-        map.insert(QStringLiteral("visible"), false);
-    }
+    DBusMenuActionProperties properties;
+    properties.setLabel(swapMnemonicChar(action->text(), QLatin1Char('&'), QLatin1Char('_')));
+    properties.setEnabled(action->isEnabled());
+    properties.setVisible(action->isVisible());
     if (action->menu()) {
-        map.insert(QStringLiteral("children-display"), QStringLiteral("submenu"));
+        properties.setSubmenu();
     }
     if (action->isCheckable()) {
         bool exclusive = action->actionGroup() && action->actionGroup()->isExclusive();
-        map.insert(QStringLiteral("toggle-type"), exclusive ? QStringLiteral("radio") : QStringLiteral("checkmark"));
-        map.insert(QStringLiteral("toggle-state"), action->isChecked() ? 1 : 0);
+        properties.setToggle(exclusive ? DBusMenuActionProperties::Radio : DBusMenuActionProperties::Checkmark, action->isChecked());
     }
-    insertIconProperty(&map, action);
+    insertIconProperty(&properties, action);
     QKeySequence keySequence = action->shortcut();
     if (!keySequence.isEmpty()) {
-        DBusMenuShortcut shortcut = DBusMenuShortcut::fromKeySequence(keySequence);
-        map.insert(QStringLiteral("shortcut"), QVariant::fromValue(shortcut));
+        properties.setShortcut(DBusMenuShortcut::fromKeySequence(keySequence));
     }
-    return map;
+    return properties;
 }
 
 QMenu *DBusMenuExporterPrivate::menuForId(int id) const
@@ -131,18 +141,20 @@ QMenu *DBusMenuExporterPrivate::menuForId(int id) const
     if (id == 0) {
         return m_rootMenu;
     }
-    QAction *action = m_actionForId.value(id);
+    QAction *action = actionForId(id);
     // Action may not be in m_actionForId if it has been deleted between the
     // time it was announced by the exporter and the time the importer asks for
     // it.
     return action ? action->menu() : nullptr;
 }
 
-void DBusMenuExporterPrivate::fillLayoutItem(DBusMenuLayoutItem *item, QMenu *menu, int id, int depth, const QStringList &propertyNames)
+void DBusMenuExporterPrivate::writeLayoutItem(QDBusArgument &argument, int id, int depth, const QStringList &propertyNames) const
 {
-    item->id = id;
-    item->properties = m_dbusObject->getProperties(id, propertyNames);
+    argument.beginStructure();
+    argument << id << m_dbusObject->getProperties(id, propertyNames);
 
+    argument.beginArray(qMetaTypeId<QDBusVariant>());
+    QMenu *menu = menuForId(id);
     if (depth != 0 && menu) {
         const auto actions = menu->actions();
         for (QAction *action : actions) {
@@ -152,11 +164,12 @@ void DBusMenuExporterPrivate::fillLayoutItem(DBusMenuLayoutItem *item, QMenu *me
                 continue;
             }
 
-            DBusMenuLayoutItem child;
-            fillLayoutItem(&child, action->menu(), actionId, depth - 1, propertyNames);
-            item->children << child;
+            // written by a nested call to this method
+            argument << QDBusVariant(QVariant::fromValue(DBusMenuLayout{this, actionId, depth - 1, propertyNames}));
         }
     }
+    argument.endArray();
+    argument.endStructure();
 }
 
 void DBusMenuExporterPrivate::updateAction(QAction *action)
@@ -176,12 +189,13 @@ void DBusMenuExporterPrivate::addAction(QAction *action, int parentId)
         DMWARNING << "Already tracking action" << action->text() << "under id" << id;
         return;
     }
-    QVariantMap map = propertiesForAction(action);
+    DBusMenuActionProperties properties = propertiesForAction(action);
     id = m_nextId++;
     QObject::connect(action, SIGNAL(destroyed(QObject *)), q, SLOT(slotActionDestroyed(QObject *)));
-    m_actionForId.insert(id, action);
+    Q_ASSERT(id == m_firstDenseId + m_actionForId.size());
+    m_actionForId.append(action);
     m_idForAction.insert(action, id);
-    m_actionProperties.insert(action, map);
+    m_actionProperties.insert(action, properties);
     if (action->menu()) {
         addMenu(action->menu(), id);
     }
@@ -198,8 +212,39 @@ void DBusMenuExporterPrivate::removeActionInternal(QObject *object)
 {
     QAction *action = static_cast<QAction *>(object);
     m_actionProperties.remove(action);
-    int id = m_idForAction.take(action);
-    m_actionForId.remove(id);
+    m_actionIconData.remove(action);
+    const int id = m_idForAction.take(action);
+    if (id <= 0) {
+        return;
+    }
+    if (id < m_firstDenseId) {
+        m_sparseActionForId.remove(id);
+        return;
+    }
+    const qsizetype index = id - m_firstDenseId;
+    if (index < m_actionForId.size() && m_actionForId.at(index)) {
+        m_actionForId[index] = nullptr;
+        ++m_deadDenseIds;
+        compactActionIds();
+    }
+}
+
+void DBusMenuExporterPrivate::compactActionIds()
+{
+    // small tables are not worth it, and moving the live actions only once
+    // half of the slots are dead keeps it linear over all the removals
+    if (m_actionForId.size() < 64 || m_deadDenseIds * 2 < m_actionForId.size()) {
+        return;
+    }
+
+    for (qsizetype index = 0; index < m_actionForId.size(); ++index) {
+        if (QAction *action = m_actionForId.at(index)) {
+            m_sparseActionForId.insert(m_firstDenseId + int(index), action);
+        }
+    }
+    m_actionForId.clear();
+    m_firstDenseId = m_nextId;
+    m_deadDenseIds = 0;
 }
 
 void DBusMenuExporterPrivate::removeAction(QAction *action, int parentId)
@@ -219,22 +264,65 @@ void DBusMenuExporterPrivate::emitLayoutUpdated(int id)
     m_layoutUpdatedTimer->start();
 }
 
-void DBusMenuExporterPrivate::insertIconProperty(QVariantMap *map, QAction *action) const
+void DBusMenuExporterPrivate::insertIconProperty(DBusMenuActionProperties *properties, QAction *action) const
 {
     // provide the icon name for per-theme lookups
-    const QString iconName = q->iconNameForAction(action);
-    if (!iconName.isEmpty()) {
-        map->insert(QStringLiteral("icon-name"), iconName);
+    properties->setIconName(q->iconNameForAction(action));
+
+    // the serialized icon data, in case the icon is unnamed or the name isn't
+    // supported by the theme, is only added on request, see iconDataForAction()
+}
+
+QIcon DBusMenuExporterPrivate::iconForAction(QAction *action) const
+{
+    if (action->objectName() == QString::fromLatin1(KMENU_TITLE)) {
+        // the icon comes from the action of the title button, see propertiesForKMenuTitleAction()
+        const QWidgetAction *widgetAction = qobject_cast<const QWidgetAction *>(action);
+        QToolButton *button = widgetAction ? qobject_cast<QToolButton *>(widgetAction->defaultWidget()) : nullptr;
+        action = button ? button->defaultAction() : nullptr;
+    } else if (action->isSeparator()) {
+        return QIcon();
     }
+    return action ? action->icon() : QIcon();
+}
 
-    // provide the serialized icon data in case the icon
-    // is unnamed or the name isn't supported by the theme
-    const QIcon icon = action->icon();
-    if (!icon.isNull()) {
-        QBuffer buffer;
-        icon.pixmap(16).save(&buffer, "PNG");
-        map->insert(QStringLiteral("icon-data"), buffer.data());
+QByteArray DBusMenuExporterPrivate::iconDataForAction(QAction *action) const
+{
+    dropStaleIconData();
+    const QIcon icon = iconForAction(action);
+
+    // a null icon keeps its entry, with no data, so that the host which asked
+    // for the icon-data is still told about an icon set later on
+    auto it = m_actionIconData.find(action);
+    if (it == m_actionIconData.end() || it->first != icon.cacheKey()) {
+        it = m_actionIconData.insert(action, {icon.cacheKey(), icon.isNull() ? QByteArray() : iconData(icon, ICON_DATA_SIZE)});
     }
+    return it->second;
+}
+
+void DBusMenuExporterPrivate::dropStaleIconData() const
+{
+    const QString themeName = QIcon::themeName();
+    if (themeName == m_iconDataThemeName) {
+        return;
+    }
+    m_iconDataThemeName = themeName;
+    m_iconDataCache.clear();
+    m_actionIconData.clear();
+}
+
+QByteArray DBusMenuExporterPrivate::iconData(const QIcon &icon, int size) const
+{
+    const std::pair<qint64, int> key(icon.cacheKey(), size);
+    if (const QByteArray *data = m_iconDataCache.object(key)) {
+        return *data;
+    }
+
+    QBuffer buffer;
+    icon.pixmap(size).save(&buffer, "PNG");
+    const QByteArray data = buffer.data();
+    m_iconDataCache.insert(key, new QByteArray(data), data.size());
+    return data;
 }
 
 static void collapseSeparator(QAction *action)
@@ -322,8 +410,12 @@ DBusMenuExporter::DBusMenuExporter(const QString &objectPath, QMenu *menu, const
     d->m_objectPath = objectPath;
     d->m_rootMenu = menu;
     d->m_nextId = 1;
+    d->m_actionForId.append(nullptr);
+    d->m_deadDenseIds = 1;
     d->m_revision = 1;
     d->m_emittedLayoutUpdatedOnce = false;
+    d->m_iconDataCache.setMaxCost(ICON_DATA_CACHE_COST);
+    d->m_iconDataThemeName = QIcon::themeName();
     d->m_itemUpdatedTimer = new QTimer(this);
     d->m_layoutUpdatedTimer = new QTimer(this);
     d->m_dbusObject = new DBusMenuExporterDBus(this);
@@ -356,45 +448,33 @@ void DBusMenuExporter::doUpdateActions()
     DBusMenuItemKeysList removedList;
 
     for (int id : d->m_itemUpdatedIds) {
-        QAction *action = d->m_actionForId.value(id);
+        QAction *action = d->actionForId(id);
         if (!action) {
             // Action does not exist anymore
             continue;
         }
 
-        QVariantMap &oldProperties = d->m_actionProperties[action];
-        QVariantMap newProperties = d->propertiesForAction(action);
-        QVariantMap updatedProperties;
-        QStringList removedProperties;
-
-        // Find updated and removed properties
-        QVariantMap::ConstIterator newEnd = newProperties.constEnd();
-
-        QVariantMap::ConstIterator oldIt = oldProperties.constBegin(), oldEnd = oldProperties.constEnd();
-        for (; oldIt != oldEnd; ++oldIt) {
-            QString key = oldIt.key();
-            QVariantMap::ConstIterator newIt = newProperties.constFind(key);
-            if (newIt != newEnd) {
-                if (newIt.value() != oldIt.value()) {
-                    updatedProperties.insert(key, newIt.value());
-                }
-            } else {
-                removedProperties << key;
-            }
-        }
+        DBusMenuActionProperties &oldProperties = d->m_actionProperties[action];
+        DBusMenuActionProperties newProperties = d->propertiesForAction(action);
 
-        // Find new properties (treat them as updated properties)
-        QVariantMap::ConstIterator newIt = newProperties.constBegin();
-        for (; newIt != newEnd; ++newIt) {
-            QString key = newIt.key();
-            oldIt = oldProperties.constFind(key);
-            if (oldIt == oldEnd) {
-                updatedProperties.insert(key, newIt.value());
+        // Only the changed fields are turned into variants
+        const DBusMenuActionProperties::Properties changed = oldProperties.changedProperties(newProperties);
+        QVariantMap updatedProperties = newProperties.toMap(changed);
+        QStringList removedProperties = DBusMenuActionProperties::names(changed & ~newProperties.present());
+
+        // Hosts which got the icon data of the action before need the new one
+        auto iconDataIt = d->m_actionIconData.constFind(action);
+        if (iconDataIt != d->m_actionIconData.constEnd() && iconDataIt->first != d->iconForAction(action).cacheKey()) {
+            const QByteArray iconData = d->iconDataForAction(action);
+            if (iconData.isEmpty()) {
+                removedProperties << QStringLiteral("icon-data");
+            } else {
+                updatedProperties.insert(QStringLiteral("icon-data"), iconData);
             }
         }
 
         // Update our data (oldProperties is a reference)
-        oldProperties = newProperties;
+        oldProperties = std::move(newProperties);
         QMenu *menu = action->menu();
         if (menu) {
             d->addMenu(menu, id);
@@ -28,14 +28,15 @@ DBusMenuExporterDBus::DBusMenuExporterDBus(DBusMenuExporter *exporter)
     new DbusmenuAdaptor(this);
 }
 
-uint DBusMenuExporterDBus::GetLayout(int parentId, int recursionDepth, const QStringList &propertyNames, DBusMenuLayoutItem &item)
+uint DBusMenuExporterDBus::GetLayout(int parentId, int recursionDepth, const QStringList &propertyNames, DBusMenuLayout &layout)
 {
     QMenu *menu = m_exporter->d->menuForId(parentId);
     DMRETURN_VALUE_IF_FAIL(menu, 0);
 
     // Process pending actions, we need them *now*
     QMetaObject::invokeMethod(m_exporter, "doUpdateActions");
-    m_exporter->d->fillLayoutItem(&item, menu, parentId, recursionDepth, propertyNames);
+    // the items are written when the reply is marshalled, right after this returns
+    layout = DBusMenuLayout{m_exporter->d, parentId, recursionDepth, propertyNames};
 
     return m_exporter->d->m_revision;
 }
@@ -43,7 +44,7 @@ uint DBusMenuExporterDBus::GetLayout(int parentId, int recursionDepth, const QSt
 void DBusMenuExporterDBus::Event(int id, const QString &eventType, const QDBusVariant & /*data*/, uint /*timestamp*/)
 {
     if (eventType == QStringLiteral("clicked")) {
-        QAction *action = m_exporter->d->m_actionForId.value(id);
+        QAction *action = m_exporter->d->actionForId(id);
         if (!action) {
             return;
         }
@@ -60,9 +61,14 @@ void DBusMenuExporterDBus::Event(int id, const QString &eventType, const QDBusVa
 
 QDBusVariant DBusMenuExporterDBus::GetProperty(int id, const QString &name)
 {
-    QAction *action = m_exporter->d->m_actionForId.value(id);
+    QAction *action = m_exporter->d->actionForId(id);
     DMRETURN_VALUE_IF_FAIL(action, QDBusVariant());
-    return QDBusVariant(m_exporter->d->m_actionProperties.value(action).value(name));
+    if (name == QLatin1String("icon-data")) {
+        const QByteArray iconData = m_exporter->d->iconDataForAction(action);
+        return iconData.isEmpty() ? QDBusVariant() : QDBusVariant(iconData);
+    }
+    const DBusMenuActionProperties properties = m_exporter->d->m_actionProperties.value(action);
+    return QDBusVariant(properties.toMap(DBusMenuActionProperties::fromNames({name})).value(name));
 }
 
 QVariantMap DBusMenuExporterDBus::getProperties(int id, const QStringList &names) const
@@ -72,21 +78,19 @@ QVariantMap DBusMenuExporterDBus::getProperties(int id, const QStringList &names
         map.insert(QStringLiteral("children-display"), QStringLiteral("submenu"));
         return map;
     }
-    QAction *action = m_exporter->d->m_actionForId.value(id);
+    QAction *action = m_exporter->d->actionForId(id);
     DMRETURN_VALUE_IF_FAIL(action, QVariantMap());
-    const QVariantMap all = m_exporter->d->m_actionProperties.value(action);
-    if (names.isEmpty()) {
-        return all;
-    } else {
-        QVariantMap map;
-        for (const QString &name : names) {
-            QVariant value = all.value(name);
-            if (value.isValid()) {
-                map.insert(name, value);
-            }
+    const DBusMenuActionProperties properties = m_exporter->d->m_actionProperties.value(action);
+    QVariantMap map = names.isEmpty() ? properties.toMap() : properties.toMap(DBusMenuActionProperties::fromNames(names));
+
+    // produced on demand, see DBusMenuExporterPrivate::iconDataForAction()
+    if (names.isEmpty() || names.contains(QLatin1String("icon-data"))) {
+        const QByteArray iconData = m_exporter->d->iconDataForAction(action);
+        if (!iconData.isEmpty()) {
+            map.insert(QStringLiteral("icon-data"), iconData);
         }
-        return map;
     }
+    return map;
 }
 
 DBusMenuItemList DBusMenuExporterDBus::GetGroupProperties(const QList<int> &ids, const QStringList &names)
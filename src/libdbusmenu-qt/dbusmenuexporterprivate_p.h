@@ -8,15 +8,19 @@
 #define DBUSMENUEXPORTERPRIVATE_P_H
 
 // Local
+#include "dbusmenuactionproperties_p.h"
 #include "dbusmenuexporter.h"
 #include "dbusmenutypes_p.h"
 
 // Qt
+#include <QByteArray>
+#include <QCache>
 #include <QHash>
-#include <QMap>
+#include <QList>
 #include <QSet>
 #include <QVariant>
 
+class QDBusArgument;
 class QMenu;
 class QTimer;
 
@@ -32,9 +36,18 @@ public:
     DBusMenuExporterDBus *m_dbusObject = nullptr;
 
     QMenu *m_rootMenu = nullptr;
-    QHash<QAction *, QVariantMap> m_actionProperties;
-    QMap<int, QAction *> m_actionForId;
-    QMap<QAction *, int> m_idForAction;
+    QHash<QAction *, DBusMenuActionProperties> m_actionProperties;
+    // Ids are handed out in sequence from m_nextId and never reused, so
+    // actions from m_firstDenseId on are looked up by indexing, with nullptr
+    // for removed ones. The root menu has id 0 and no action.
+    // Once most slots are dead, as in menus rebuilt over and over, the live
+    // actions move to m_sparseActionForId and the table starts over at the
+    // next id, see compactActionIds().
+    QList<QAction *> m_actionForId;
+    QHash<int, QAction *> m_sparseActionForId;
+    QHash<QAction *, int> m_idForAction;
+    int m_firstDenseId = 0;
+    int m_deadDenseIds = 0;
     int m_nextId;
     uint m_revision;
     bool m_emittedLayoutUpdatedOnce;
@@ -45,14 +58,28 @@ public:
     QSet<int> m_layoutUpdatedIds;
     QTimer *m_layoutUpdatedTimer = nullptr;
 
+    // PNG data of the action icons, keyed by QIcon::cacheKey() and pixmap
+    // size, so that updating an action does not encode its icon again
+    mutable QCache<std::pair<qint64, int>, QByteArray> m_iconDataCache;
+
+    // The "icon-data" property is left out of m_actionProperties and only
+    // produced once a host asks for it. Holds what was handed out, with the
+    // cache key of the icon it was produced from.
+    mutable QHash<QAction *, std::pair<qint64, QByteArray>> m_actionIconData;
+
+    // A theme icon keeps its cache key when the icon theme changes, so the
+    // two caches above are only valid for the theme they were filled with
+    mutable QString m_iconDataThemeName;
+
     int idForAction(QAction *action) const;
+    QAction *actionForId(int id) const;
     void addMenu(QMenu *menu, int parentId);
-    QVariantMap propertiesForAction(QAction *action) const;
-    QVariantMap propertiesForKMenuTitleAction(QAction *action_) const;
-    QVariantMap propertiesForSeparatorAction(QAction *action) const;
-    QVariantMap propertiesForStandardAction(QAction *action) const;
+    DBusMenuActionProperties propertiesForAction(QAction *action) const;
+    DBusMenuActionProperties propertiesForKMenuTitleAction(QAction *action_) const;
+    DBusMenuActionProperties propertiesForSeparatorAction(QAction *action) const;
+    DBusMenuActionProperties propertiesForStandardAction(QAction *action) const;
     QMenu *menuForId(int id) const;
-    void fillLayoutItem(DBusMenuLayoutItem *item, QMenu *menu, int id, int depth, const QStringList &propertyNames);
+    void writeLayoutItem(QDBusArgument &argument, int id, int depth, const QStringList &propertyNames) const;
 
     void addAction(QAction *action, int parentId);
     void updateAction(QAction *action);
@@ -66,10 +93,15 @@ public:
      * tempted to dereference)
      */
     void removeActionInternal(QObject *action);
+    void compactActionIds();
 
     void emitLayoutUpdated(int id);
 
-    void insertIconProperty(QVariantMap *map, QAction *action) const;
+    void insertIconProperty(DBusMenuActionProperties *properties, QAction *action) const;
+    QIcon iconForAction(QAction *action) const;
+    QByteArray iconDataForAction(QAction *action) const;
+    void dropStaleIconData() const;
+    QByteArray iconData(const QIcon &icon, int size) const;
 
     void collapseSeparators(QMenu *);
 };
@@ -7,6 +7,7 @@
 #include "dbusmenutypes_p.h"
 
 // Local
+#include "dbusmenuexporterprivate_p.h"
 #include "dbusmenushortcut_p.h"
 #include "debug_p.h"
 
@@ -82,6 +83,27 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, DBusMenuLayoutIte
     return argument;
 }
 
+//// DBusMenuLayout
+QDBusArgument &operator<<(QDBusArgument &argument, const DBusMenuLayout &obj)
+{
+    if (obj.exporter) {
+        obj.exporter->writeLayoutItem(argument, obj.id, obj.depth, obj.propertyNames);
+    } else {
+        // an empty item, QtDBus marshals a default constructed value to get the signature
+        argument << DBusMenuLayoutItem{0, {}, {}};
+    }
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, DBusMenuLayout &obj)
+{
+    // a layout only refers to a local exporter, it cannot be read back
+    DBusMenuLayoutItem item;
+    argument >> item;
+    obj = DBusMenuLayout();
+    return argument;
+}
+
 void DBusMenuTypes_register()
 {
     static bool registered = false;
@@ -94,6 +116,7 @@ void DBusMenuTypes_register()
     qDBusRegisterMetaType<DBusMenuItemKeysList>();
     qDBusRegisterMetaType<DBusMenuLayoutItem>();
     qDBusRegisterMetaType<DBusMenuLayoutItemList>();
+    qDBusRegisterMetaType<DBusMenuLayout>();
     qDBusRegisterMetaType<DBusMenuShortcut>();
     registered = true;
 }
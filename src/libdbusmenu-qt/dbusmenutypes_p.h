@@ -13,6 +13,7 @@
 #include <QVariant>
 
 class QDBusArgument;
+class DBusMenuExporterPrivate;
 
 //// DBusMenuItem
 /**
@@ -71,5 +72,24 @@ typedef QList<DBusMenuLayoutItem> DBusMenuLayoutItemList;
 
 Q_DECLARE_METATYPE(DBusMenuLayoutItemList)
 
+//// DBusMenuLayout
+/**
+ * The layout returned by GetLayout(). It has the same DBus signature as
+ * DBusMenuLayoutItem, but only refers to a menu item of the exporter: the
+ * item and its children are written straight from the exporter tables into
+ * the reply when it is marshalled, without building a DBusMenuLayoutItem tree.
+ */
+struct DBusMenuLayout {
+    const DBusMenuExporterPrivate *exporter = nullptr;
+    int id = 0;
+    int depth = 0;
+    QStringList propertyNames;
+};
+
+Q_DECLARE_METATYPE(DBusMenuLayout)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const DBusMenuLayout &);
+const QDBusArgument &operator>>(const QDBusArgument &argument, DBusMenuLayout &);
+
 void DBusMenuTypes_register();
 #endif /* DBUSMENUTYPES_P_H */